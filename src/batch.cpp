@@ -0,0 +1,346 @@
+//      batch.cpp
+//      
+//      Copyright 2010 Kevin Pors <krpors@users.sf.net>
+//      
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//      
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//      
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//      MA 02110-1301, USA.
+
+#include "batch.hpp"
+#include "glext.hpp"
+#include "vec3.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+namespace ogle {
+
+/// Floats per vertex of the unit cube: the position followed by the normal.
+static const GLuint CUBE_VERTEX_FLOATS = 6;
+
+/// Vertices of the unit cube: six quads.
+static const GLuint CUBE_VERTICES = 24;
+
+/// Corners of the unit cube, with the faces in the same order as the geometry
+/// of Box.
+static const GLfloat CUBE_CORNERS[CUBE_VERTICES * 3] = {
+    // 'front' face
+    1.0f, 1.0f, 0.0f,
+    0.0f, 1.0f, 0.0f,
+    0.0f, 0.0f, 0.0f,
+    1.0f, 0.0f, 0.0f,
+    // 'back' face
+    1.0f, 1.0f, 1.0f,
+    0.0f, 1.0f, 1.0f,
+    0.0f, 0.0f, 1.0f,
+    1.0f, 0.0f, 1.0f,
+    // 'top' face
+    1.0f, 1.0f, 1.0f,
+    0.0f, 1.0f, 1.0f,
+    0.0f, 1.0f, 0.0f,
+    1.0f, 1.0f, 0.0f,
+    // 'bottom' face
+    1.0f, 0.0f, 1.0f,
+    0.0f, 0.0f, 1.0f,
+    0.0f, 0.0f, 0.0f,
+    1.0f, 0.0f, 0.0f,
+    // 'left' face
+    0.0f, 0.0f, 0.0f,
+    0.0f, 1.0f, 0.0f,
+    0.0f, 1.0f, 1.0f,
+    0.0f, 0.0f, 1.0f,
+    // 'right' face
+    1.0f, 0.0f, 0.0f,
+    1.0f, 1.0f, 0.0f,
+    1.0f, 1.0f, 1.0f,
+    1.0f, 0.0f, 1.0f
+};
+
+/**
+ * Gets the outward normal of a vertex of the unit cube.
+ * 
+ * @param vertex The index of the vertex, below CUBE_VERTICES.
+ * @return The normal of the face the vertex belongs to.
+ */
+static Vec3 cubeNormal(const GLuint& vertex) {
+    switch(vertex / 4) {
+        case 0:
+            return -UNIT_Z;
+        case 1:
+            return UNIT_Z;
+        case 2:
+            return UNIT_Y;
+        case 3:
+            return -UNIT_Y;
+        case 4:
+            return -UNIT_X;
+        default:
+            return UNIT_X;
+    }
+}
+
+/// Vertex shader for instanced boxes. Does the lighting of the fixed function
+/// pipeline for GL_LIGHT0, per vertex.
+static const char* BOX_VERTEX_SHADER =
+    "#version 120\n"
+    "attribute vec3 corner;\n"
+    "attribute vec3 normal;\n"
+    "attribute vec3 offset;\n"
+    "attribute vec3 size;\n"
+    "uniform int lighting;\n"
+    "uniform int light0;\n"
+    "varying vec4 boxColor;\n"
+    "void main() {\n"
+    "    vec4 vertex = gl_ModelViewMatrix * vec4(offset + corner * size, 1.0);\n"
+    "    gl_Position = gl_ProjectionMatrix * vertex;\n"
+    "    if(lighting == 0) {\n"
+    "        boxColor = gl_Color;\n"
+    "        return;\n"
+    "    }\n"
+    "    vec4 color = gl_FrontLightModelProduct.sceneColor;\n"
+    "    if(light0 != 0) {\n"
+    "        vec3 n = normalize(gl_NormalMatrix * normal);\n"
+    "        vec4 light = gl_LightSource[0].position;\n"
+    "        vec3 l = normalize(light.w == 0.0 ? light.xyz : light.xyz - vertex.xyz);\n"
+    "        float diffuse = max(dot(n, l), 0.0);\n"
+    "        color += gl_FrontLightProduct[0].ambient + diffuse * gl_FrontLightProduct[0].diffuse;\n"
+    "        if(diffuse > 0.0) {\n"
+    "            vec3 h = normalize(l + vec3(0.0, 0.0, 1.0));\n"
+    "            color += pow(max(dot(n, h), 0.0), gl_FrontMaterial.shininess) * gl_FrontLightProduct[0].specular;\n"
+    "        }\n"
+    "    }\n"
+    "    boxColor = clamp(vec4(color.rgb, gl_FrontMaterial.diffuse.a), 0.0, 1.0);\n"
+    "}\n";
+
+/// Fragment shader for instanced boxes.
+static const char* BOX_FRAGMENT_SHADER =
+    "#version 120\n"
+    "varying vec4 boxColor;\n"
+    "void main() {\n"
+    "    gl_FragColor = boxColor;\n"
+    "}\n";
+
+/// Vertex attribute indices of the box shader.
+enum BoxAttribute {
+    ATTRIB_CORNER = 0,
+    ATTRIB_NORMAL,
+    ATTRIB_OFFSET,
+    ATTRIB_SIZE
+};
+
+BoxBatch::BoxBatch() :
+        m_changed(true),
+        m_instanced(false),
+        m_cubeBuilt(false),
+        m_color(1.0f, 0.0f, 0.0f, 1.0f),
+        m_shader(BOX_VERTEX_SHADER, BOX_FRAGMENT_SHADER) {
+    m_shader.bindAttribute(ATTRIB_CORNER, "corner");
+    m_shader.bindAttribute(ATTRIB_NORMAL, "normal");
+    m_shader.bindAttribute(ATTRIB_OFFSET, "offset");
+    m_shader.bindAttribute(ATTRIB_SIZE,   "size");
+    m_cube.setUsage(GL_STATIC_DRAW);
+    m_data.setUsage(GL_DYNAMIC_DRAW);
+}
+
+BoxBatch::~BoxBatch() {
+}
+
+void BoxBatch::addBox(Box* const box) {
+    m_boxes.push_back(box);
+    m_changed = true;
+}
+
+void BoxBatch::removeBox(Box* const box) {
+    std::vector<Box*>::iterator it = std::find(m_boxes.begin(), m_boxes.end(), box);
+    if(it != m_boxes.end()) {
+        m_boxes.erase(it);
+        m_changed = true;
+    }
+}
+
+void BoxBatch::clear() {
+    m_boxes.clear();
+    m_changed = true;
+}
+
+GLuint BoxBatch::getSize() const {
+    return m_boxes.size();
+}
+
+void BoxBatch::setColor(const Color& color) {
+    m_color = color;
+}
+
+const Color& BoxBatch::getColor() const {
+    return m_color;
+}
+
+void BoxBatch::refresh() {
+    const GLuint size = m_boxes.size();
+    if(m_instances.size() != size) {
+        m_instances.resize(size);
+        m_changed = true;
+    }
+    for(GLuint i = 0; i < size; i++) {
+        const Box* box = m_boxes[i];
+        BoxInstance& instance = m_instances[i];
+        if(instance.x != box->getX() || instance.y != box->getY() || instance.z != box->getZ() ||
+           instance.w != box->getWidth() || instance.h != box->getHeight() || instance.d != box->getDepth()) {
+            instance.x = box->getX();
+            instance.y = box->getY();
+            instance.z = box->getZ();
+            instance.w = box->getWidth();
+            instance.h = box->getHeight();
+            instance.d = box->getDepth();
+            m_changed = true;
+        }
+    }
+}
+
+void BoxBatch::render() {
+    GLExtensions::load();
+    refresh();
+    if(m_instances.empty()) {
+        return;
+    }
+    
+    // the material is the same for all boxes, so it's set only once.
+    const GLfloat color[] = { m_color.getR(), m_color.getG(), m_color.getB(), m_color.getA() };
+    glMaterialfv(GL_FRONT, GL_AMBIENT_AND_DIFFUSE, color);
+    glFrontFace(GL_CCW);
+    
+    if(GLExtensions::hasInstancing() && m_shader.use()) {
+        renderInstanced();
+        ShaderProgram::release();
+    } else {
+        renderExpanded();
+    }
+}
+
+void BoxBatch::renderInstanced() {
+    if(!m_cubeBuilt) {
+        GLfloat* cube = static_cast<GLfloat*>(m_cube.map(CUBE_VERTICES * CUBE_VERTEX_FLOATS * sizeof(GLfloat)));
+        if(cube == NULL) {
+            return;
+        }
+        for(GLuint v = 0; v < CUBE_VERTICES; v++) {
+            const Vec3 normal = cubeNormal(v);
+            cube[0] = CUBE_CORNERS[v * 3 + 0];
+            cube[1] = CUBE_CORNERS[v * 3 + 1];
+            cube[2] = CUBE_CORNERS[v * 3 + 2];
+            cube[3] = normal.x;
+            cube[4] = normal.y;
+            cube[5] = normal.z;
+            cube += CUBE_VERTEX_FLOATS;
+        }
+        m_cubeBuilt = m_cube.unmap();
+        m_cube.unbind();
+        if(!m_cubeBuilt) {
+            return;
+        }
+    }
+    
+    const GLsizeiptr bytes = m_instances.size() * sizeof(BoxInstance);
+    if(m_changed || !m_instanced) {
+        GLvoid* data = m_data.map(bytes);
+        if(data == NULL) {
+            return;
+        }
+        memcpy(data, &m_instances[0], bytes);
+        if(!m_data.unmap()) {
+            m_data.unbind();
+            return;
+        }
+        m_changed = false;
+        m_instanced = true;
+    } else {
+        m_data.bind();
+    }
+    
+    const GLsizei stride = sizeof(BoxInstance);
+    const GLubyte* instances = m_data.getPointer();
+    GLExtensions::vertexAttribPointer(ATTRIB_OFFSET, 3, GL_FLOAT, GL_FALSE, stride, instances + offsetof(BoxInstance, x));
+    GLExtensions::vertexAttribPointer(ATTRIB_SIZE, 3, GL_FLOAT, GL_FALSE, stride, instances + offsetof(BoxInstance, w));
+    m_data.unbind();
+    
+    const GLsizei cubeStride = CUBE_VERTEX_FLOATS * sizeof(GLfloat);
+    m_cube.bind();
+    const GLubyte* cube = m_cube.getPointer();
+    GLExtensions::vertexAttribPointer(ATTRIB_CORNER, 3, GL_FLOAT, GL_FALSE, cubeStride, cube);
+    GLExtensions::vertexAttribPointer(ATTRIB_NORMAL, 3, GL_FLOAT, GL_FALSE, cubeStride, cube + 3 * sizeof(GLfloat));
+    m_cube.unbind();
+    
+    GLExtensions::uniform1i(m_shader.getUniform("lighting"), glIsEnabled(GL_LIGHTING));
+    GLExtensions::uniform1i(m_shader.getUniform("light0"), glIsEnabled(GL_LIGHT0));
+    
+    for(GLuint i = ATTRIB_CORNER; i <= ATTRIB_SIZE; i++) {
+        GLExtensions::enableVertexAttribArray(i);
+        GLExtensions::vertexAttribDivisor(i, i >= ATTRIB_OFFSET ? 1 : 0);
+    }
+    
+    GLExtensions::drawArraysInstanced(GL_QUADS, 0, CUBE_VERTICES, m_instances.size());
+    
+    // leave the attribute state as we found it.
+    for(GLuint i = ATTRIB_CORNER; i <= ATTRIB_SIZE; i++) {
+        GLExtensions::vertexAttribDivisor(i, 0);
+        GLExtensions::disableVertexAttribArray(i);
+    }
+}
+
+void BoxBatch::renderExpanded() {
+    const GLuint size = m_instances.size();
+    if(m_changed || m_instanced) {
+        GLfloat* out = static_cast<GLfloat*>(m_data.map(CUBE_VERTICES * CUBE_VERTEX_FLOATS * sizeof(GLfloat) * size));
+        if(out == NULL) {
+            return;
+        }
+        for(GLuint i = 0; i < size; i++) {
+            const BoxInstance& box = m_instances[i];
+            const GLfloat* in = CUBE_CORNERS;
+            for(GLuint v = 0; v < CUBE_VERTICES; v++) {
+                const Vec3 normal = cubeNormal(v);
+                out[0] = box.x + in[0] * box.w;
+                out[1] = box.y + in[1] * box.h;
+                out[2] = box.z + in[2] * box.d;
+                out[3] = normal.x;
+                out[4] = normal.y;
+                out[5] = normal.z;
+                in += 3;
+                out += CUBE_VERTEX_FLOATS;
+            }
+        }
+        if(!m_data.unmap()) {
+            m_data.unbind();
+            return;
+        }
+        m_changed = false;
+        m_instanced = false;
+    } else {
+        m_data.bind();
+    }
+    
+    const GLsizei stride = CUBE_VERTEX_FLOATS * sizeof(GLfloat);
+    const GLubyte* base = m_data.getPointer();
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glVertexPointer(3, GL_FLOAT, stride, base);
+    glNormalPointer(GL_FLOAT, stride, base + 3 * sizeof(GLfloat));
+    glDrawArrays(GL_QUADS, 0, size * CUBE_VERTICES);
+    glDisableClientState(GL_NORMAL_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    m_data.unbind();
+}
+
+} // namespace ogle
@@ -0,0 +1,151 @@
+//      batch.hpp
+//      
+//      Copyright 2010 Kevin Pors <krpors@users.sf.net>
+//      
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//      
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//      
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//      MA 02110-1301, USA.
+
+#ifndef BATCH_HPP
+#define BATCH_HPP
+
+#include "buffer.hpp"
+#include "core.hpp"
+#include "shader.hpp"
+
+#include <GL/gl.h>
+#include <vector>
+
+namespace ogle {
+
+/**
+ * Renders many boxes at once. All boxes share the geometry of a unit cube, 
+ * which is moved and scaled to every box by a per-instance buffer holding the
+ * position and size of each box, so all boxes take a single draw call and 
+ * the material is set only once. The instance buffer is only rewritten when a
+ * box changed.
+ * 
+ * Needs instancing and shaders, see GLExtensions::hasInstancing(). Without 
+ * them, the faces of all boxes are written into a single vertex buffer 
+ * instead, which still takes a single draw call. Either way the boxes are lit
+ * by GL_LIGHT0 only, like the rest of Ogle.
+ * 
+ * The batch does not own the boxes, and Box::render() keeps working for boxes
+ * drawn on their own.
+ */
+class BoxBatch {
+private:
+    /// Position and size of a single box, as stored in the instance buffer.
+    struct BoxInstance {
+        GLfloat x, y, z;
+        GLfloat w, h, d;
+    };
+    
+    /// The boxes to render.
+    std::vector<Box*> m_boxes;
+    
+    /// The boxes as written to m_data the last time.
+    std::vector<BoxInstance> m_instances;
+    
+    /// Whether m_data needs to be rewritten.
+    bool m_changed;
+    
+    /// Whether m_data holds instances, or the faces of all boxes.
+    bool m_instanced;
+    
+    /// Whether m_cube holds the unit cube.
+    bool m_cubeBuilt;
+    
+    /// The material color of the boxes.
+    Color m_color;
+    
+    /// The unit cube, for instancing.
+    VertexBuffer m_cube;
+    
+    /// The instances, or the faces of all boxes without instancing.
+    VertexBuffer m_data;
+    
+    /// Shader moving the unit cube to every instance.
+    ShaderProgram m_shader;
+    
+    /**
+     * Takes the current position and size of every box, and sets m_changed 
+     * when any of them changed.
+     */
+    void refresh();
+    
+    /**
+     * Renders the boxes using instancing.
+     */
+    void renderInstanced();
+    
+    /**
+     * Renders the boxes from a single buffer with the faces of all boxes.
+     */
+    void renderExpanded();
+    
+public:
+    /**
+     * Creates an empty batch. No OpenGL calls are made until render().
+     */
+    BoxBatch();
+    
+    ~BoxBatch();
+    
+    /**
+     * Adds a box to render. The batch does not take ownership.
+     * 
+     * @param box The box.
+     */
+    void addBox(Box* const box);
+    
+    /**
+     * Removes a box from the batch.
+     * 
+     * @param box The box.
+     */
+    void removeBox(Box* const box);
+    
+    /**
+     * Removes all boxes from the batch.
+     */
+    void clear();
+    
+    /**
+     * Gets the amount of boxes in the batch.
+     * 
+     * @return The amount of boxes.
+     */
+    GLuint getSize() const;
+    
+    /**
+     * Sets the ambient and diffuse material color of all boxes. Defaults to 
+     * red, like Box::render().
+     * 
+     * @param color The color.
+     */
+    void setColor(const Color& color);
+    
+    const Color& getColor() const;
+    
+    /**
+     * Renders all boxes.
+     */
+    void render();
+};
+
+} // namespace ogle
+
+
+#endif // BATCH_HPP
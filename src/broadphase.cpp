@@ -0,0 +1,420 @@
+//      broadphase.cpp
+//      
+//      Copyright 2010 Kevin Pors <krpors@users.sf.net>
+//      
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//      
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//      
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//      MA 02110-1301, USA.
+
+#include "broadphase.hpp"
+
+#include <math.h>
+#include <algorithm>
+
+namespace ogle {
+
+bool CollisionPair::operator<(const CollisionPair& other) const {
+    if(first != other.first) {
+        return first < other.first;
+    }
+    return second < other.second;
+}
+
+bool CollisionPair::operator==(const CollisionPair& other) const {
+    return first == other.first && second == other.second;
+}
+
+//==============================================================================
+
+Broadphase::Broadphase() {
+}
+
+Broadphase::~Broadphase() {
+}
+
+void Broadphase::findPairs(const std::vector<AABB3>& boxes, std::vector<CollisionPair>& pairs) {
+    const GLuint size = boxes.size();
+    m_projected.resize(size);
+    for(GLuint i = 0; i < size; i++) {
+        m_projected[i] = boxes[i].getRect();
+    }
+    
+    m_projectedPairs.clear();
+    findPairs(m_projected, m_projectedPairs);
+    
+    // touching boxes count as overlapping, like in AABB3::intersects().
+    std::vector<CollisionPair>::const_iterator it;
+    for(it = m_projectedPairs.begin(); it != m_projectedPairs.end(); it++) {
+        const AABB3& one = boxes[it->first];
+        const AABB3& two = boxes[it->second];
+        if(std::min(one.z, one.z + one.d) <= std::max(two.z, two.z + two.d) &&
+           std::min(two.z, two.z + two.d) <= std::max(one.z, one.z + one.d)) {
+            pairs.push_back(*it);
+        }
+    }
+}
+
+//==============================================================================
+
+BruteForceBroadphase::BruteForceBroadphase() {
+}
+
+BruteForceBroadphase::~BruteForceBroadphase() {
+}
+
+/**
+ * Appends every pair of the given amount of boxes.
+ */
+static void findAllPairs(const GLuint& size, std::vector<CollisionPair>& pairs) {
+    for(GLuint i = 0; i < size; i++) {
+        for(GLuint j = i + 1; j < size; j++) {
+            CollisionPair pair;
+            pair.first = i;
+            pair.second = j;
+            pairs.push_back(pair);
+        }
+    }
+}
+
+void BruteForceBroadphase::findPairs(const std::vector<Rect>& boxes, std::vector<CollisionPair>& pairs) {
+    findAllPairs(boxes.size(), pairs);
+}
+
+void BruteForceBroadphase::findPairs(const std::vector<AABB3>& boxes, std::vector<CollisionPair>& pairs) {
+    findAllPairs(boxes.size(), pairs);
+}
+
+//==============================================================================
+
+SpatialHash::SpatialHash(const GLfloat& cellSize) :
+        m_cellSize(cellSize) {
+}
+
+SpatialHash::~SpatialHash() {
+}
+
+void SpatialHash::setCellSize(const GLfloat& cellSize) {
+    m_cellSize = cellSize;
+}
+
+const GLfloat& SpatialHash::getCellSize() const {
+    return m_cellSize;
+}
+
+GLfloat SpatialHash::getCellSize(const std::vector<Rect>& boxes) const {
+    if(m_cellSize > 0.0f) {
+        return m_cellSize;
+    }
+    
+    double total = 0.0;
+    std::vector<Rect>::const_iterator it;
+    for(it = boxes.begin(); it != boxes.end(); it++) {
+        total += std::max(fabsf(it->w), fabsf(it->h));
+    }
+    GLfloat size = static_cast<GLfloat>(2.0 * total / boxes.size());
+    return size > 0.0f ? size : 1.0f;
+}
+
+/// Boxes covering more cells than this are not hashed, but tested against all
+/// other boxes instead.
+static const GLuint MAX_CELLS_PER_BOX = 16;
+
+/// Largest cell coordinate, in both directions. Well within a GLint, and small
+/// enough for a float to hold every coordinate exactly.
+static const GLfloat CELL_LIMIT = 16777216.0f;
+
+/**
+ * Converts a coordinate, already divided by the cell size, to a cell. The cell
+ * is clamped to the limit, which keeps the cells of overlapping boxes 
+ * overlapping.
+ */
+static inline GLint toCell(const GLfloat& v) {
+    const GLfloat cell = floorf(v);
+    // written so NaN ends up at the lower limit as well.
+    if(!(cell >= -CELL_LIMIT)) {
+        return static_cast<GLint>(-CELL_LIMIT);
+    }
+    if(!(cell <= CELL_LIMIT)) {
+        return static_cast<GLint>(CELL_LIMIT);
+    }
+    return static_cast<GLint>(cell);
+}
+
+/**
+ * Checks whether two boxes overlap, the way they are hashed: boxes with a
+ * negative size extend to the left or bottom, and touching boxes overlap.
+ */
+static inline bool overlaps(const Rect& a, const Rect& b) {
+    return std::min(a.x, a.x + a.w) <= std::max(b.x, b.x + b.w) &&
+           std::min(b.x, b.x + b.w) <= std::max(a.x, a.x + a.w) &&
+           std::min(a.y, a.y + a.h) <= std::max(b.y, b.y + b.h) &&
+           std::min(b.y, b.y + b.h) <= std::max(a.y, a.y + a.h);
+}
+
+/**
+ * Hashes cell coordinates.
+ */
+static inline GLuint hashCell(const GLint& cx, const GLint& cy) {
+    return (static_cast<GLuint>(cx) * 73856093U) ^ (static_cast<GLuint>(cy) * 19349663U);
+}
+
+void SpatialHash::findPairs(const std::vector<Rect>& boxes, std::vector<CollisionPair>& pairs) {
+    const GLuint size = boxes.size();
+    if(size < 2) {
+        return;
+    }
+    
+    const GLfloat scale = 1.0f / getCellSize(boxes);
+    
+    // put every box in the cells it overlaps. The far edges are included, 
+    // since Rect::intersects() counts touching boxes as intersecting.
+    m_entries.clear();
+    m_oversized.clear();
+    m_firstX.resize(size);
+    m_firstY.resize(size);
+    for(GLuint i = 0; i < size; i++) {
+        const Rect& box = boxes[i];
+        // boxes with a negative size extend to the left or bottom instead.
+        const GLfloat right = box.x + box.w;
+        const GLfloat top   = box.y + box.h;
+        const GLint x1 = toCell(std::min(box.x, right) * scale);
+        const GLint y1 = toCell(std::min(box.y, top) * scale);
+        const GLint x2 = toCell(std::max(box.x, right) * scale);
+        const GLint y2 = toCell(std::max(box.y, top) * scale);
+        m_firstX[i] = x1;
+        m_firstY[i] = y1;
+        // in doubles, the amount of cells may not fit in an integer.
+        const double cells = (static_cast<double>(x2) - x1 + 1.0) * (static_cast<double>(y2) - y1 + 1.0);
+        if(cells > MAX_CELLS_PER_BOX) {
+            m_oversized.push_back(i);
+            continue;
+        }
+        for(GLint cy = y1; cy <= y2; cy++) {
+            for(GLint cx = x1; cx <= x2; cx++) {
+                Entry entry;
+                entry.cx = cx;
+                entry.cy = cy;
+                entry.index = i;
+                m_entries.push_back(entry);
+            }
+        }
+    }
+    
+    // table with at least twice as many slots as entries, so most slots hold
+    // a single cell.
+    GLuint slots = 1;
+    while(slots < 2 * m_entries.size()) {
+        slots <<= 1;
+    }
+    
+    // counting sort of the entries by slot.
+    m_slots.assign(slots + 1, 0);
+    std::vector<Entry>::iterator it;
+    for(it = m_entries.begin(); it != m_entries.end(); it++) {
+        it->slot = hashCell(it->cx, it->cy) & (slots - 1);
+        m_slots[it->slot + 1]++;
+    }
+    for(GLuint s = 0; s < slots; s++) {
+        m_slots[s + 1] += m_slots[s];
+    }
+    m_sorted.resize(m_entries.size());
+    for(it = m_entries.begin(); it != m_entries.end(); it++) {
+        m_sorted[m_slots[it->slot]++] = *it;
+    }
+    // the starts were moved to the ends, shift them back.
+    for(GLuint s = slots; s > 0; s--) {
+        m_slots[s] = m_slots[s - 1];
+    }
+    m_slots[0] = 0;
+    
+    for(GLuint s = 0; s < slots; s++) {
+        const GLuint end = m_slots[s + 1];
+        for(GLuint a = m_slots[s]; a < end; a++) {
+            const Entry& one = m_sorted[a];
+            for(GLuint b = a + 1; b < end; b++) {
+                const Entry& two = m_sorted[b];
+                // different cells ending up in the same slot.
+                if(one.cx != two.cx || one.cy != two.cy) {
+                    continue;
+                }
+                // boxes sharing several cells are only paired in the first
+                // cell they share.
+                if(one.cx != std::max(m_firstX[one.index], m_firstX[two.index]) ||
+                   one.cy != std::max(m_firstY[one.index], m_firstY[two.index])) {
+                    continue;
+                }
+                CollisionPair pair;
+                pair.first  = std::min(one.index, two.index);
+                pair.second = std::max(one.index, two.index);
+                pairs.push_back(pair);
+            }
+        }
+    }    
+    // the oversized boxes against all other boxes, and each other once.
+    m_isOversized.assign(size, 0);
+    std::vector<GLuint>::const_iterator big;
+    for(big = m_oversized.begin(); big != m_oversized.end(); big++) {
+        m_isOversized[*big] = 1;
+    }
+    for(big = m_oversized.begin(); big != m_oversized.end(); big++) {
+        const Rect& box = boxes[*big];
+        for(GLuint j = 0; j < size; j++) {
+            if(j == *big || (m_isOversized[j] && j < *big) || !overlaps(box, boxes[j])) {
+                continue;
+            }
+            CollisionPair pair;
+            pair.first  = std::min(*big, j);
+            pair.second = std::max(*big, j);
+            pairs.push_back(pair);
+        }
+    }
+}
+
+//==============================================================================
+
+SweepAndPrune::SweepAndPrune(const SweepAxis& axis) :
+        m_axis(axis) {
+}
+
+SweepAndPrune::~SweepAndPrune() {
+}
+
+const SweepAxis& SweepAndPrune::getAxis() const {
+    return m_axis;
+}
+
+/**
+ * Orders box indices by where the boxes start.
+ */
+class StartsBefore {
+private:
+    const std::vector<GLfloat>& m_min;
+    
+public:
+    StartsBefore(const std::vector<GLfloat>& min) : m_min(min) {
+    }
+    
+    bool operator()(const GLuint& one, const GLuint& two) const {
+        return m_min[one] < m_min[two];
+    }
+};
+
+void SweepAndPrune::sort(const GLuint& size) {
+    // drop the boxes which are gone, and add the new ones at the end.
+    GLuint kept = 0;
+    for(GLuint k = 0; k < m_order.size(); k++) {
+        if(m_order[k] < size) {
+            m_order[kept++] = m_order[k];
+        }
+    }
+    const GLuint added = size - kept;
+    m_order.resize(kept);
+    for(GLuint i = kept; i < size; i++) {
+        m_order.push_back(i);
+    }
+    
+    // many new boxes are in arbitrary places, which an insertion sort handles
+    // badly.
+    if(added > size / 4) {
+        std::sort(m_order.begin(), m_order.end(), StartsBefore(m_min));
+        return;
+    }
+    
+    for(GLuint k = 1; k < size; k++) {
+        const GLuint index = m_order[k];
+        const GLfloat min = m_min[index];
+        GLuint at = k;
+        while(at > 0 && m_min[m_order[at - 1]] > min) {
+            m_order[at] = m_order[at - 1];
+            at--;
+        }
+        m_order[at] = index;
+    }
+}
+
+void SweepAndPrune::setExtents(const GLuint& i, const GLfloat& x, const GLfloat& y, const GLfloat& w, const GLfloat& h) {
+    // boxes with a negative size extend to the left or bottom instead.
+    const GLfloat x1 = std::min(x, x + w);
+    const GLfloat x2 = std::max(x, x + w);
+    const GLfloat y1 = std::min(y, y + h);
+    const GLfloat y2 = std::max(y, y + h);
+    if(m_axis == SWEEP_X) {
+        m_min[i]      = x1;
+        m_max[i]      = x2;
+        m_crossMin[i] = y1;
+        m_crossMax[i] = y2;
+    } else {
+        m_min[i]      = y1;
+        m_max[i]      = y2;
+        m_crossMin[i] = x1;
+        m_crossMax[i] = x2;
+    }
+}
+
+void SweepAndPrune::sweep(const GLuint& size, bool depth, std::vector<CollisionPair>& pairs) const {
+    // touching boxes count as overlapping, like in Rect::intersects().
+    for(GLuint a = 0; a < size; a++) {
+        const GLuint one = m_order[a];
+        const GLfloat end = m_max[one];
+        for(GLuint b = a + 1; b < size && m_min[m_order[b]] <= end; b++) {
+            const GLuint two = m_order[b];
+            if(m_crossMin[one] > m_crossMax[two] || m_crossMin[two] > m_crossMax[one]) {
+                continue;
+            }
+            if(depth && (m_depthMin[one] > m_depthMax[two] || m_depthMin[two] > m_depthMax[one])) {
+                continue;
+            }
+            CollisionPair pair;
+            pair.first  = std::min(one, two);
+            pair.second = std::max(one, two);
+            pairs.push_back(pair);
+        }
+    }
+}
+
+void SweepAndPrune::findPairs(const std::vector<Rect>& boxes, std::vector<CollisionPair>& pairs) {
+    const GLuint size = boxes.size();
+    m_min.resize(size);
+    m_max.resize(size);
+    m_crossMin.resize(size);
+    m_crossMax.resize(size);
+    for(GLuint i = 0; i < size; i++) {
+        const Rect& box = boxes[i];
+        setExtents(i, box.x, box.y, box.w, box.h);
+    }
+    
+    sort(size);
+    sweep(size, false, pairs);
+}
+
+void SweepAndPrune::findPairs(const std::vector<AABB3>& boxes, std::vector<CollisionPair>& pairs) {
+    const GLuint size = boxes.size();
+    m_min.resize(size);
+    m_max.resize(size);
+    m_crossMin.resize(size);
+    m_crossMax.resize(size);
+    m_depthMin.resize(size);
+    m_depthMax.resize(size);
+    for(GLuint i = 0; i < size; i++) {
+        const AABB3& box = boxes[i];
+        setExtents(i, box.x, box.y, box.w, box.h);
+        m_depthMin[i] = std::min(box.z, box.z + box.d);
+        m_depthMax[i] = std::max(box.z, box.z + box.d);
+    }
+    
+    sort(size);
+    sweep(size, true, pairs);
+}
+
+} // namespace ogle
@@ -0,0 +1,278 @@
+//      broadphase.hpp
+//      
+//      Copyright 2010 Kevin Pors <krpors@users.sf.net>
+//      
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//      
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//      
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//      MA 02110-1301, USA.
+
+#ifndef BROADPHASE_HPP
+#define BROADPHASE_HPP
+
+#include "core.hpp"
+
+#include <GL/gl.h>
+#include <vector>
+
+namespace ogle {
+
+/**
+ * Two boxes which (may) collide, by their index. The first index is always
+ * smaller than the second one.
+ */
+struct CollisionPair {
+    /// Index of the first box.
+    GLuint first;
+    
+    /// Index of the second box.
+    GLuint second;
+    
+    /**
+     * Orders pairs by the first index, then by the second.
+     */
+    bool operator<(const CollisionPair& other) const;
+    
+    /**
+     * Checks whether both pairs refer to the same boxes.
+     */
+    bool operator==(const CollisionPair& other) const;
+};
+
+//==============================================================================
+
+/**
+ * A broadphase quickly finds the pairs of boxes which may collide, so only 
+ * those need to be tested exactly. Implementations may keep state between 
+ * calls to speed up the next one, so a single broadphase should be used for a 
+ * single set of boxes.
+ */
+class Broadphase {
+public:
+    Broadphase();
+    
+    virtual ~Broadphase();
+    
+    /**
+     * Finds the candidate pairs. Every pair of intersecting boxes must be 
+     * reported exactly once, but pairs which do not intersect may be reported
+     * too. The order of the pairs is not defined.
+     * 
+     * @param boxes The boxes, as returned by Object::getBoundary().
+     * @param pairs The vector to append the candidate pairs to.
+     */
+    virtual void findPairs(const std::vector<Rect>& boxes, std::vector<CollisionPair>& pairs) = 0;
+    
+    /**
+     * Finds the candidate pairs of boxes in three dimensions, with the same
+     * guarantees as the 2D version. By default, finds the candidates of the 
+     * boxes projected on the xy plane, and drops the pairs which are apart 
+     * along the z-axis.
+     * 
+     * @param boxes The boxes, as returned by Object::getBoundary3D().
+     * @param pairs The vector to append the candidate pairs to.
+     */
+    virtual void findPairs(const std::vector<AABB3>& boxes, std::vector<CollisionPair>& pairs);
+    
+protected:
+    /// The 3D boxes projected on the xy plane.
+    std::vector<Rect> m_projected;
+    
+    /// Candidates of the projected boxes.
+    std::vector<CollisionPair> m_projectedPairs;
+};
+
+//==============================================================================
+
+/**
+ * Reports every pair of boxes, in <code>O(n^2)</code>. Mostly useful as a 
+ * reference for the other broadphases.
+ */
+class BruteForceBroadphase : public Broadphase {
+public:
+    BruteForceBroadphase();
+    
+    virtual ~BruteForceBroadphase();
+    
+    virtual void findPairs(const std::vector<Rect>& boxes, std::vector<CollisionPair>& pairs);
+    
+    virtual void findPairs(const std::vector<AABB3>& boxes, std::vector<CollisionPair>& pairs);
+};
+
+//==============================================================================
+
+/**
+ * Uniform grid broadphase. Every box is put in the cells it overlaps, and only
+ * boxes sharing a cell are paired. The cells are hashed into a table instead 
+ * of being stored as a grid, so the world does not need to be bounded. All 
+ * memory is kept between calls, so after the first frame no allocations are 
+ * done unless the amount of boxes grows.
+ * 
+ * Works best when the cells are a bit bigger than the boxes: then every box is
+ * in at most four cells. Boxes which cover many cells, like a box the size of
+ * the level, are not hashed but tested against every other box, so they cost
+ * <code>O(n)</code> each instead of a lot of cells. Cells far from the origin
+ * are clamped to a limit, which may pair more boxes there, but never less.
+ */
+class SpatialHash : public Broadphase {
+private:
+    /// A box put in a cell.
+    struct Entry {
+        /// Slot of the cell in the hash table.
+        GLuint slot;
+        
+        /// Cell coordinates.
+        GLint cx, cy;
+        
+        /// Index of the box.
+        GLuint index;
+    };
+    
+    /// Size of the cells, or 0 to derive it from the boxes.
+    GLfloat m_cellSize;
+    
+    /// Entries in the order they were created.
+    std::vector<Entry> m_entries;
+    
+    /// Entries sorted by slot.
+    std::vector<Entry> m_sorted;
+    
+    /// Start of every slot in m_sorted, plus the end of the last one.
+    std::vector<GLuint> m_slots;
+    
+    /// First cell of every box along x.
+    std::vector<GLint> m_firstX;
+    
+    /// First cell of every box along y.
+    std::vector<GLint> m_firstY;
+    
+    /// Boxes covering too many cells to hash, by index.
+    std::vector<GLuint> m_oversized;
+    
+    /// Whether every box is in m_oversized (non-zero) or not (zero).
+    std::vector<GLubyte> m_isOversized;
+    
+    /**
+     * Gets the cell size to use for the given boxes.
+     */
+    GLfloat getCellSize(const std::vector<Rect>& boxes) const;
+
+public:
+    /**
+     * Creates the spatial hash.
+     * 
+     * @param cellSize The size of the cells, or 0 to use twice the average 
+     *   size of the boxes, recalculated every call.
+     */
+    SpatialHash(const GLfloat& cellSize = 0.0f);
+    
+    virtual ~SpatialHash();
+    
+    /**
+     * Sets the size of the cells.
+     * 
+     * @param cellSize The size of the cells, or 0 for automatic.
+     */
+    void setCellSize(const GLfloat& cellSize);
+    
+    const GLfloat& getCellSize() const;
+    
+    virtual void findPairs(const std::vector<Rect>& boxes, std::vector<CollisionPair>& pairs);
+    
+    // hashes the boxes on the xy plane only, and culls along z after.
+    using Broadphase::findPairs;
+};
+
+//==============================================================================
+
+/// The axis along which SweepAndPrune sorts the boxes.
+enum SweepAxis {
+    SWEEP_X,
+    SWEEP_Y
+};
+
+/**
+ * Sort and sweep broadphase. The boxes are sorted by where they start along 
+ * one axis, after which a single sweep pairs every box with the boxes starting
+ * before it ends. Only pairs which overlap on the other axis are reported, and
+ * on the z-axis as well for boxes in three dimensions.
+ * 
+ * The order is kept between calls and fixed with an insertion sort, which is
+ * close to <code>O(n)</code> when the boxes move little between calls, like 
+ * particles do. Pick the axis along which the boxes are spread out most, so 
+ * few boxes overlap on it.
+ */
+class SweepAndPrune : public Broadphase {
+private:
+    /// The axis to sort along.
+    SweepAxis m_axis;
+    
+    /// Indices of the boxes, ordered by m_min.
+    std::vector<GLuint> m_order;
+    
+    /// Start of every box along the sweep axis.
+    std::vector<GLfloat> m_min;
+    
+    /// End of every box along the sweep axis.
+    std::vector<GLfloat> m_max;
+    
+    /// Start of every box along the other axis.
+    std::vector<GLfloat> m_crossMin;
+    
+    /// End of every box along the other axis.
+    std::vector<GLfloat> m_crossMax;
+    
+    /// Start of every box along the z-axis, for boxes in three dimensions.
+    std::vector<GLfloat> m_depthMin;
+    
+    /// End of every box along the z-axis.
+    std::vector<GLfloat> m_depthMax;
+    
+    /**
+     * Fills the extents along the sweep axis and the other axis of a box.
+     */
+    void setExtents(const GLuint& i, const GLfloat& x, const GLfloat& y, const GLfloat& w, const GLfloat& h);
+    
+    /**
+     * Brings m_order up to date with the given amount of boxes, and sorts it.
+     */
+    void sort(const GLuint& size);
+    
+    /**
+     * Sweeps the sorted boxes, reporting the pairs which overlap.
+     * 
+     * @param depth Whether to test the overlap on the z-axis too.
+     */
+    void sweep(const GLuint& size, bool depth, std::vector<CollisionPair>& pairs) const;
+
+public:
+    /**
+     * Creates the broadphase.
+     * 
+     * @param axis The axis to sort along.
+     */
+    SweepAndPrune(const SweepAxis& axis = SWEEP_X);
+    
+    virtual ~SweepAndPrune();
+    
+    const SweepAxis& getAxis() const;
+    
+    virtual void findPairs(const std::vector<Rect>& boxes, std::vector<CollisionPair>& pairs);
+    
+    virtual void findPairs(const std::vector<AABB3>& boxes, std::vector<CollisionPair>& pairs);
+};
+
+} // namespace ogle
+
+
+#endif // BROADPHASE_HPP
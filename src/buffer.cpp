@@ -0,0 +1,128 @@
+//      buffer.cpp
+//      
+//      Copyright 2010 Kevin Pors <krpors@users.sf.net>
+//      
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//      
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//      
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//      MA 02110-1301, USA.
+
+#include "buffer.hpp"
+
+namespace ogle {
+
+VertexBuffer::VertexBuffer() :
+        m_id(0),
+        m_size(0),
+        m_mapped(false),
+        m_useBufferObjects(true),
+        m_usage(GL_STREAM_DRAW) {
+}
+
+VertexBuffer::VertexBuffer(const VertexBuffer& other) :
+        m_id(0),
+        m_size(0),
+        m_mapped(false),
+        m_useBufferObjects(other.m_useBufferObjects),
+        m_usage(other.m_usage) {
+}
+
+VertexBuffer& VertexBuffer::operator=(const VertexBuffer& other) {
+    m_useBufferObjects = other.m_useBufferObjects;
+    m_usage = other.m_usage;
+    return *this;
+}
+
+VertexBuffer::~VertexBuffer() {
+    if(m_id != 0) {
+        GLExtensions::deleteBuffers(1, &m_id);
+    }
+}
+
+void VertexBuffer::setUseBufferObjects(bool use) {
+    m_useBufferObjects = use;
+}
+
+bool VertexBuffer::isBufferObject() const {
+    return m_useBufferObjects && GLExtensions::hasBufferObjects();
+}
+
+void VertexBuffer::setUsage(const GLenum& usage) {
+    m_usage = usage;
+}
+
+GLvoid* VertexBuffer::map(const GLsizeiptr& size) {
+    GLExtensions::load();
+    
+    if(isBufferObject()) {
+        if(m_id == 0) {
+            GLExtensions::genBuffers(1, &m_id);
+        }
+        GLExtensions::bindBuffer(GL_ARRAY_BUFFER, m_id);
+        // orphan the previous storage; the driver hands out fresh memory while
+        // the old one may still be in use for drawing.
+        GLExtensions::bufferData(GL_ARRAY_BUFFER, size, NULL, m_usage);
+        m_size = size;
+        GLvoid* data = GLExtensions::mapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
+        if(data != NULL) {
+            m_mapped = true;
+            return data;
+        }
+        // mapping failed, write into client memory and upload that.
+    }
+    
+    if(m_client.size() < static_cast<size_t>(size)) {
+        m_client.resize(size);
+    }
+    return m_client.empty() ? NULL : &m_client[0];
+}
+
+bool VertexBuffer::unmap() {
+    if(!isBufferObject()) {
+        return true;
+    }
+    if(m_mapped) {
+        m_mapped = false;
+        if(GLExtensions::unmapBuffer(GL_ARRAY_BUFFER)) {
+            return true;
+        }
+        // the contents got lost (e.g. due to a mode switch); nothing to draw.
+        GLExtensions::bufferData(GL_ARRAY_BUFFER, m_size, NULL, m_usage);
+        return false;
+    }
+    if(!m_client.empty()) {
+        GLExtensions::bufferSubData(GL_ARRAY_BUFFER, 0, m_size, &m_client[0]);
+    }
+    return true;
+}
+
+const GLubyte* VertexBuffer::getPointer() const {
+    if(isBufferObject()) {
+        return NULL;
+    }
+    return m_client.empty() ? NULL : &m_client[0];
+}
+
+void VertexBuffer::bind() {
+    if(isBufferObject() && m_id != 0) {
+        GLExtensions::bindBuffer(GL_ARRAY_BUFFER, m_id);
+    }
+}
+
+void VertexBuffer::unbind() {
+    if(isBufferObject()) {
+        GLExtensions::bindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+}
+
+} // namespace ogle
@@ -0,0 +1,153 @@
+//      buffer.hpp
+//      
+//      Copyright 2010 Kevin Pors <krpors@users.sf.net>
+//      
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//      
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//      
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//      MA 02110-1301, USA.
+
+#ifndef BUFFER_HPP
+#define BUFFER_HPP
+
+#include "glext.hpp"
+
+#include <GL/gl.h>
+#include <cstddef>
+#include <vector>
+
+namespace ogle {
+
+/**
+ * A buffer for vertex data which is rewritten every frame. When buffer objects
+ * are available, the data is written straight into a buffer object, which is
+ * orphaned first so the driver doesn't have to wait for the previous frame to
+ * finish drawing from it. Otherwise, the data is kept in a client side array, 
+ * which can be drawn using plain OpenGL 1.1 vertex arrays.
+ * 
+ * Usage: map() the buffer, write the vertices, unmap() it, set up the vertex
+ * pointers using getPointer() plus the offsets of the attributes, draw, and 
+ * finally unbind(). Data which does not change every frame can be drawn again
+ * later after bind(), without writing it again.
+ * 
+ * A copy of a buffer starts out empty, so two buffers never share a buffer 
+ * object.
+ */
+class VertexBuffer {
+private:
+    /// The buffer object, or 0 when not created (yet).
+    GLuint m_id;
+    
+    /// Size of the buffer object in bytes.
+    GLsizeiptr m_size;
+    
+    /// Client side memory, used when buffer objects are not available.
+    std::vector<GLubyte> m_client;
+    
+    /// Whether the buffer object is currently mapped.
+    bool m_mapped;
+    
+    /// Whether buffer objects should be used, if available.
+    bool m_useBufferObjects;
+    
+    /// The usage hint for the buffer object.
+    GLenum m_usage;
+
+public:
+    /**
+     * Creates the vertex buffer. No OpenGL calls are made until map().
+     */
+    VertexBuffer();
+    
+    /**
+     * Destroys the buffer object, if any.
+     */
+    ~VertexBuffer();
+    
+    /**
+     * Creates an empty buffer with the same settings as another one.
+     */
+    VertexBuffer(const VertexBuffer& other);
+    
+    /**
+     * Takes the settings of another buffer, keeping the own contents.
+     */
+    VertexBuffer& operator=(const VertexBuffer& other);
+    
+    /**
+     * Sets whether to use buffer objects when available. When disabled, a
+     * client side array is used instead. Defaults to true.
+     * 
+     * @param use true to use buffer objects.
+     */
+    void setUseBufferObjects(bool use);
+    
+    /**
+     * Checks whether the data is kept in a buffer object.
+     * 
+     * @return true when using a buffer object, false when using a client array.
+     */
+    bool isBufferObject() const;
+    
+    /**
+     * Sets the usage hint given to the driver for the buffer object, like 
+     * GL_STATIC_DRAW for data which is written once and drawn many times. 
+     * Defaults to GL_STREAM_DRAW, for data rewritten every frame.
+     * 
+     * @param usage The usage hint.
+     */
+    void setUsage(const GLenum& usage);
+    
+    /**
+     * Discards the previous contents and gives memory to write the new 
+     * contents in. When using a buffer object, it stays bound until unbind().
+     * 
+     * @param size The size in bytes.
+     * @return Pointer to the memory to write into, valid until unmap().
+     */
+    GLvoid* map(const GLsizeiptr& size);
+    
+    /**
+     * Finishes writing the contents. The buffer object may lose its contents
+     * while mapped, for example when the display mode changes; then the 
+     * contents have to be written again.
+     * 
+     * @return false when the contents got lost, and nothing should be drawn.
+     */
+    bool unmap();
+    
+    /**
+     * Gets the pointer to pass to glVertexPointer() and friends, to point at
+     * the start of the buffer. For a buffer object this is an offset of 0, for
+     * a client array the actual address.
+     * 
+     * @return The pointer to the start of the buffer.
+     */
+    const GLubyte* getPointer() const;
+    
+    /**
+     * Binds the buffer object, if any, to draw the contents written before.
+     */
+    void bind();
+    
+    /**
+     * Unbinds the buffer object, if any, so it doesn't affect other vertex
+     * arrays.
+     */
+    void unbind();
+};
+
+} // namespace ogle
+
+
+#endif // BUFFER_HPP
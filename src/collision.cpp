@@ -18,15 +18,126 @@
 //      MA 02110-1301, USA.
 
 #include "collision.hpp"
+#include "simd.hpp"
+
+#include <cmath>
 
 namespace ogle {
 
+/**
+ * Sweeps a box against a target on a single axis, narrowing the times between
+ * enter and leave to the times during which they overlap on that axis.
+ * 
+ * @return false when they do not overlap at any of those times.
+ */
+static bool sweepAxis(const GLfloat& pos, const GLfloat& size, const GLfloat& d, 
+        const GLfloat& targetPos, const GLfloat& targetSize, GLfloat& enter, GLfloat& leave) {
+    const GLfloat min = std::min(pos, pos + size);
+    const GLfloat max = std::max(pos, pos + size);
+    const GLfloat targetMin = std::min(targetPos, targetPos + targetSize);
+    const GLfloat targetMax = std::max(targetPos, targetPos + targetSize);
+    
+    if(d == 0.0f) {
+        return max >= targetMin && min <= targetMax;
+    }
+    
+    GLfloat first = (targetMin - max) / d;
+    GLfloat last = (targetMax - min) / d;
+    if(first > last) {
+        std::swap(first, last);
+    }
+    enter = std::max(enter, first);
+    leave = std::min(leave, last);
+    return enter <= leave;
+}
+
+bool sweepRects(const Rect& box, const GLfloat& dx, const GLfloat& dy, const Rect& target, GLfloat& time) {
+    GLfloat enter = 0.0f;
+    GLfloat leave = 1.0f;
+    if(!sweepAxis(box.x, box.w, dx, target.x, target.w, enter, leave) ||
+       !sweepAxis(box.y, box.h, dy, target.y, target.h, enter, leave)) {
+        return false;
+    }
+    time = enter;
+    return true;
+}
+
+Rect sweptRect(const Rect& box, const GLfloat& dx, const GLfloat& dy) {
+    const GLfloat minX = std::min(box.x, box.x + box.w) + std::min(0.0f, dx);
+    const GLfloat minY = std::min(box.y, box.y + box.h) + std::min(0.0f, dy);
+    const GLfloat maxX = std::max(box.x, box.x + box.w) + std::max(0.0f, dx);
+    const GLfloat maxY = std::max(box.y, box.y + box.h) + std::max(0.0f, dy);
+    return Rect(minX, minY, maxX - minX, maxY - minY);
+}
+
+bool sweepBoxes(const AABB3& box, const GLfloat& dx, const GLfloat& dy, const GLfloat& dz, 
+        const AABB3& target, GLfloat& time) {
+    GLfloat enter = 0.0f;
+    GLfloat leave = 1.0f;
+    if(!sweepAxis(box.x, box.w, dx, target.x, target.w, enter, leave) ||
+       !sweepAxis(box.y, box.h, dy, target.y, target.h, enter, leave) ||
+       !sweepAxis(box.z, box.d, dz, target.z, target.d, enter, leave)) {
+        return false;
+    }
+    time = enter;
+    return true;
+}
+
+AABB3 sweptBox(const AABB3& box, const GLfloat& dx, const GLfloat& dy, const GLfloat& dz) {
+    const Rect rect = sweptRect(box.getRect(), dx, dy);
+    const GLfloat minZ = std::min(box.z, box.z + box.d) + std::min(0.0f, dz);
+    const GLfloat maxZ = std::max(box.z, box.z + box.d) + std::max(0.0f, dz);
+    return AABB3(rect, minZ, maxZ - minZ);
+}
+
+//==============================================================================
+
+CollisionBatch::CollisionBatch() {
+}
+
+CollisionBatch::~CollisionBatch() {
+}
+
+void CollisionBatch::clear() {
+    particles.clear();
+    pairs.clear();
+    outOfBounds.clear();
+    objects.clear();
+}
+
+bool CollisionBatch::empty() const {
+    return pairs.empty() && outOfBounds.empty() && objects.empty();
+}
+
+//==============================================================================
+
 CollisionBehavior::CollisionBehavior() {
 }
 
 CollisionBehavior::~CollisionBehavior() {
 }
 
+void CollisionBehavior::collided(const CollisionBatch& batch) {
+    // a particle is either out of bounds, or the first of its pairs, so 
+    // merging both sorted lists gives the order of the particles.
+    std::vector<CollisionPair>::const_iterator pair = batch.pairs.begin();
+    std::vector<GLuint>::const_iterator out = batch.outOfBounds.begin();
+    while(pair != batch.pairs.end() || out != batch.outOfBounds.end()) {
+        if(out != batch.outOfBounds.end() && (pair == batch.pairs.end() || *out < pair->first)) {
+            boundsCollided(batch.particles[*out], batch.bounds);
+            out++;
+        } else {
+            particlesCollided(batch.particles[pair->first], batch.particles[pair->second]);
+            pair++;
+        }
+    }
+    
+    std::vector<ObjectCollision>::const_iterator it;
+    for(it = batch.objects.begin(); it != batch.objects.end(); it++) {
+        objectCollided(batch.particles[it->particle], it->object);
+    }
+}
+
 void CollisionBehavior::particlesCollided(Particle* const one, Particle* const two) {
 
 }
@@ -46,28 +157,50 @@ void CollisionBehavior::boundsCollided(Particle* const particle, const Rect& bou
     }
 }
 
+void CollisionBehavior::objectCollided(Particle* const particle, Object* const object) {
+
+}
+
 //==============================================================================
 
-CollisionDetector::CollisionDetector(const Rect& bounds) :
-        m_bounds(bounds) {
+CollisionJob::CollisionJob(CollisionDetector* const detector) :
+        detector(detector),
+        begin(0),
+        end(0) {
 }
 
-CollisionDetector::~CollisionDetector() {
+CollisionJob::~CollisionJob() {
 }
 
-void CollisionDetector::fireBoundsCollided(Particle* const one, const Rect& rect) {
-    std::vector<CollisionBehavior*>::iterator it;
-    for(it = m_behaviors.begin(); it < m_behaviors.end(); it++) {
-        CollisionBehavior* cb = *it;
-        cb->boundsCollided(one, rect);
-    }
+void CollisionJob::execute() {
+    detector->testPairs(*this);
+}
+
+//==============================================================================
+
+CollisionDetector::CollisionDetector(const Rect& bounds, Broadphase* const broadphase) :
+        m_bounds(bounds),
+        m_broadphase(broadphase),
+        m_fastCount(0),
+        m_continuous(true),
+        m_depthCulling(false),
+        m_pool(NULL),
+        m_boundsResponse(false),
+        m_geometry(NULL) {
 }
 
-void CollisionDetector::fireParticlesCollided(Particle* const one, Particle* const two) {
+CollisionDetector::~CollisionDetector() {
+}
+
+void CollisionDetector::fireCollided() {
+    if(m_batch.empty()) {
+        return;
+    }
+    m_batch.bounds = m_bounds;
     std::vector<CollisionBehavior*>::iterator it;
     for(it = m_behaviors.begin(); it < m_behaviors.end(); it++) {
         CollisionBehavior* cb = *it;
-        cb->particlesCollided(one, two);
+        cb->collided(m_batch);
     }
 }
 
@@ -75,53 +208,427 @@ void CollisionDetector::addBehavior(CollisionBehavior* const behavior) {
     m_behaviors.push_back(behavior);
 }
 
+void CollisionDetector::setJobPool(JobPool* const pool) {
+    m_pool = pool;
+}
+
+JobPool* CollisionDetector::getJobPool() const {
+    return m_pool;
+}
+
+void CollisionDetector::setBoundsResponse(bool apply) {
+    m_boundsResponse = apply;
+}
+
+bool CollisionDetector::isBoundsResponse() const {
+    return m_boundsResponse;
+}
+
+void CollisionDetector::setGeometry(DynamicTree* const geometry) {
+    m_geometry = geometry;
+}
+
+DynamicTree* CollisionDetector::getGeometry() const {
+    return m_geometry;
+}
+
+void CollisionDetector::setContinuous(bool continuous) {
+    m_continuous = continuous;
+}
+
+bool CollisionDetector::isContinuous() const {
+    return m_continuous;
+}
+
+void CollisionDetector::setDepthCulling(bool culling) {
+    m_depthCulling = culling;
+}
+
+bool CollisionDetector::isDepthCulling() const {
+    return m_depthCulling;
+}
+
+
+/// What checkCollisions() does with a particle.
+enum ParticleCheck {
+    /// Not eligible for collisions.
+    CHECK_NONE,
+    
+    /// Out of bounds, so only the bounds collision is reported.
+    CHECK_BOUNDS,
+    
+    /// In bounds, so collisions with the particles after it are reported.
+    CHECK_PAIRS
+};
 
-void CollisionDetector::checkCollisions(std::vector<Particle*> particles) {
-    /* 
-     * This function will iterate over a one dimensional vector (duh), and it will
-     * compare all the Particles with each other. This comparison will be done only
-     * once per set: suppose we have the particles A B C and D. The check will be
-     * done like:
-     * 
-     * A - B, A - C, A - D (first loop)
-     * B - C, B - D (second loop)
-     * C - D (third loop)
-     * 
-     * That means B - A will never happen, or C - A etc; what would be the point
-     * to compare them twice?
+GLubyte CollisionDetector::classify(const GLfloat& x, const GLfloat& y, bool eligible) const {
+    if(!eligible) {
+        return CHECK_NONE;
+    }
+    if(x <= m_bounds.x || 
+       x >= m_bounds.w ||
+       y <= m_bounds.y ||
+       y >= m_bounds.h) {
+        return CHECK_BOUNDS;
+    }
+    return CHECK_PAIRS;
+}
+
+void CollisionDetector::findFastParticles() {
+    const GLuint size = m_boxes.size();
+    m_fast.resize(size);
+    m_fastCount = 0;
+    if(!m_continuous) {
+        return;
+    }
+    
+    for(GLuint i = 0; i < size; i++) {
+        // particles are flat, so any move along z would exceed their depth.
+        // Their width or height stands in for it instead.
+        const AABB3& box = m_boxes[i];
+        const GLfloat depth = std::max(std::fabs(box.w), std::fabs(box.h));
+        m_fast[i] = std::fabs(m_dx[i]) > std::fabs(box.w) || 
+                    std::fabs(m_dy[i]) > std::fabs(box.h) ||
+                    std::fabs(m_dz[i]) > depth;
+        m_fastCount += m_fast[i];
+    }
+    if(m_fastCount == 0) {
+        return;
+    }
+    
+    // the boxes are where the particles ended up, so they are swept back to
+    // where they started. A slow particle may still meet a fast one anywhere
+    // along its own move, so all of them are swept.
+    m_swept.resize(size);
+    for(GLuint i = 0; i < size; i++) {
+        m_swept[i] = sweptBox(m_boxes[i], -m_dx[i], -m_dy[i], -m_dz[i]);
+    }
+}
+
+bool CollisionDetector::collides(const GLuint& i, const GLuint& j) const {
+    if(m_boxes[i].intersects(m_boxes[j])) {
+        return true;
+    }
+    if(m_fastCount == 0 || !(m_fast[i] || m_fast[j])) {
+        return false;
+    }
+    
+    // sweep i relative to j, both from where they started.
+    const AABB3& a = m_boxes[i];
+    const AABB3& b = m_boxes[j];
+    const AABB3 start(a.x - m_dx[i], a.y - m_dy[i], a.z - m_dz[i], a.w, a.h, a.d);
+    const AABB3 target(b.x - m_dx[j], b.y - m_dy[j], b.z - m_dz[j], b.w, b.h, b.d);
+    GLfloat time;
+    return sweepBoxes(start, m_dx[i] - m_dx[j], m_dy[i] - m_dy[j], m_dz[i] - m_dz[j], target, time);
+}
+
+/// Least amount of pair tests worth a job of their own.
+static const double PAIRS_PER_JOB = 16384.0;
+
+void CollisionDetector::testPairs(CollisionJob& job) const {
+    job.pairs.clear();
+    
+    if(m_broadphase == NULL) {
+        /* 
+         * Without a broadphase, the job is a range of particles which are 
+         * compared with all particles after them. This comparison will be done
+         * only once per set: suppose we have the particles A B C and D. The 
+         * check will be done like:
+         * 
+         * A - B, A - C, A - D (first loop)
+         * B - C, B - D (second loop)
+         * C - D (third loop)
+         * 
+         * That means B - A will never happen, or C - A etc; what would be the
+         * point to compare them twice?
+         */
+        const GLuint size = m_boxes.size();
+        for(GLuint i = job.begin; i < job.end; i++) {
+            if(m_checks[i] != CHECK_PAIRS) {
+                continue;
+            }
+            for(GLuint j = i + 1; j < size; j++) {
+                if(collides(i, j)) {
+                    CollisionPair pair;
+                    pair.first = i;
+                    pair.second = j;
+                    job.pairs.push_back(pair);
+                }
+            }
+        }
+        return;
+    }
+    
+    for(GLuint k = job.begin; k < job.end; k++) {
+        const CollisionPair& pair = m_candidates[k];
+        if(m_checks[pair.first] == CHECK_PAIRS && collides(pair.first, pair.second)) {
+            job.pairs.push_back(pair);
+        }
+    }
+}
+
+void CollisionDetector::findCollisions() {
+    /*
+     * A particle which is out of bounds only collides with the bounds, and a 
+     * pair is only reported by the first particle of the pair. The second one
+     * may be anything.
      */
-    std::vector<Particle*>::iterator it1;
-    for(it1 = particles.begin(); it1 < particles.end(); it1++) {
-        // first particle in iteration.
-        Particle* p1 = *it1; 
-        
-        // only check for collisions when this particle is enabled to
-        if(!p1->isCollisionEligible()) {
-            continue;
+    const GLuint size = m_boxes.size();
+    
+    // the amount of things to split over the jobs, and the pair tests to do.
+    GLuint total;
+    double tests;
+    if(m_broadphase == NULL) {
+        total = size;
+        tests = 0.5 * size * (size - 1.0);
+    } else {
+        m_candidates.clear();
+        // fast particles may collide anywhere along their move.
+        m_broadphase->findPairs(m_fastCount > 0 ? m_swept : m_boxes, m_candidates);
+        total = m_candidates.size();
+        tests = total;
+    }
+    
+    GLuint jobs = 1;
+    if(m_pool != NULL && m_pool->getThreadCount() > 1 && tests > PAIRS_PER_JOB) {
+        // a few jobs per thread, since they won't take equally long.
+        jobs = m_pool->getThreadCount() * 4;
+        jobs = static_cast<GLuint>(std::min<double>(jobs, tests / PAIRS_PER_JOB));
+    }
+    if(m_jobs.size() < jobs) {
+        m_jobs.resize(jobs, CollisionJob(this));
+    }
+    
+    // split evenly by the amount of tests. Without a broadphase, particle i 
+    // is tested against the size - 1 - i particles after it.
+    GLuint begin = 0;
+    double done = 0.0;
+    for(GLuint k = 0; k < jobs; k++) {
+        CollisionJob& job = m_jobs[k];
+        job.detector = this;
+        job.begin = begin;
+        if(k == jobs - 1) {
+            begin = total;
+        } else if(m_broadphase == NULL) {
+            const double target = tests * (k + 1) / jobs;
+            while(begin < total && done < target) {
+                done += size - 1.0 - begin;
+                begin++;
+            }
+        } else {
+            begin = static_cast<GLuint>(static_cast<double>(total) * (k + 1) / jobs);
         }
-        
-        // check first for 'out of bounds' collisions:
-        if (p1->getX() <= m_bounds.x || 
-            p1->getX() >= m_bounds.w ||
-            p1->getY() <= m_bounds.y ||
-            p1->getY() >= m_bounds.h) {
-            
-            fireBoundsCollided(p1, m_bounds);
-            // no need really to check for particle collision?
-            // XXX: evaluate this!
+        job.end = begin;
+    }
+    
+    if(jobs == 1) {
+        testPairs(m_jobs[0]);
+    } else {
+        for(GLuint k = 0; k < jobs; k++) {
+            m_pool->add(&m_jobs[k]);
+        }
+        m_pool->run();
+    }
+    
+    // merge in job order, so the result does not depend on which thread 
+    // finished first.
+    std::vector<CollisionPair>& pairs = m_batch.pairs;
+    pairs.clear();
+    for(GLuint k = 0; k < jobs; k++) {
+        pairs.insert(pairs.end(), m_jobs[k].pairs.begin(), m_jobs[k].pairs.end());
+    }
+    if(m_broadphase != NULL) {
+        std::sort(pairs.begin(), pairs.end());
+    }
+}
+
+void CollisionDetector::fillBatch() {
+    m_batch.outOfBounds.clear();
+    const GLuint size = m_checks.size();
+    for(GLuint i = 0; i < size; i++) {
+        if(m_checks[i] == CHECK_BOUNDS) {
+            m_batch.outOfBounds.push_back(i);
+        }
+    }
+}
+
+void CollisionDetector::findObjectCollisions() {
+    m_batch.objects.clear();
+    if(m_geometry == NULL) {
+        return;
+    }
+    const GLuint size = m_boxes.size();
+    for(GLuint i = 0; i < size; i++) {
+        if(m_checks[i] != CHECK_PAIRS) {
             continue;
         }
+        m_hits.clear();
+        const bool fast = m_fastCount > 0 && m_fast[i];
+        const AABB3& box = m_boxes[i];
+        m_geometry->queryRect(fast ? m_swept[i].getRect() : box.getRect(), m_hits);
         
-        std::vector<Particle*>::iterator it2;
-        for(it2 = (it1 + 1); it2 < particles.end(); it2++) {
-            // particle to check the first one with.
-            Particle* p2 = *it2;
-            
-            // do they intersect?
-            if(p1->getBoundary().intersects(p2->getBoundary())) {
-                fireParticlesCollided(p1, p2);
+        // the tree only tests on the xy plane.
+        const AABB3 start(box.x - m_dx[i], box.y - m_dy[i], box.z - m_dz[i], box.w, box.h, box.d);
+        std::vector<Object*>::const_iterator it;
+        for(it = m_hits.begin(); it != m_hits.end(); it++) {
+            if(fast || m_depthCulling) {
+                const AABB3 target = m_depthCulling ? (*it)->getBoundary3D() : AABB3((*it)->getBoundary());
+                GLfloat time;
+                if(!box.intersects(target) && 
+                   !(fast && sweepBoxes(start, m_dx[i], m_dy[i], m_dz[i], target, time))) {
+                    continue;
+                }
+            }
+            ObjectCollision collision;
+            collision.particle = i;
+            collision.object = *it;
+            m_batch.objects.push_back(collision);
+        }
+    }
+}
+
+void CollisionDetector::checkParticles() {
+    const std::vector<Particle*>& particles = m_batch.particles;
+    const GLuint size = particles.size();
+    m_boxes.resize(size);
+    m_dx.resize(size);
+    m_dy.resize(size);
+    m_dz.resize(size);
+    m_checks.resize(size);
+    for(GLuint i = 0; i < size; i++) {
+        Particle* p = particles[i];
+        // gravity was added to the velocity after the move.
+        m_dx[i] = p->getXv();
+        m_dy[i] = p->getYv() - p->getGravity();
+        if(m_depthCulling) {
+            m_boxes[i] = p->getBoundary3D();
+            m_dz[i] = p->getZv();
+        } else {
+            m_boxes[i] = AABB3(p->getBoundary());
+            m_dz[i] = 0.0f;
+        }
+        m_checks[i] = classify(p->getX(), p->getY(), p->isCollisionEligible());
+    }
+    
+    findFastParticles();
+    findCollisions();
+    findObjectCollisions();
+    fillBatch();
+    fireCollided();
+}
+
+void CollisionDetector::checkCollisions(const std::vector<Particle*>& particles) {
+    m_batch.particles.assign(particles.begin(), particles.end());
+    checkParticles();
+}
+
+void CollisionDetector::checkCollisions(Particle* const particles, const GLuint& count) {
+    m_batch.particles.resize(count);
+    for(GLuint i = 0; i < count; i++) {
+        m_batch.particles[i] = particles + i;
+    }
+    checkParticles();
+}
+
+/**
+ * Stores a particle loaded from the storage back. ParticleStorage::store() 
+ * resets the previous position, which is only wanted when the particle was
+ * moved, since it would stop interpolation otherwise.
+ */
+static void storeParticle(ParticleStorage& storage, const GLuint& i, const Particle& p) {
+    const bool moved = p.getX() != storage.x[i] || p.getY() != storage.y[i] || p.getZ() != storage.z[i];
+    const GLfloat px = storage.px[i];
+    const GLfloat py = storage.py[i];
+    const GLfloat pz = storage.pz[i];
+    storage.store(i, p);
+    if(!moved) {
+        storage.px[i] = px;
+        storage.py[i] = py;
+        storage.pz[i] = pz;
+    }
+}
+
+void CollisionDetector::checkCollisions(ParticleGenerator& generator) {
+    ParticleStorage& storage = generator.getStorage();
+    const GLuint size = generator.getAliveCount();
+    
+    m_boxes.resize(size);
+    m_dx.resize(size);
+    m_dy.resize(size);
+    m_dz.resize(size);
+    m_checks.resize(size);
+    for(GLuint i = 0; i < size; i++) {
+        // particles are flat, like their quads.
+        const GLfloat z = m_depthCulling ? storage.z[i] : 0.0f;
+        m_boxes[i] = AABB3(storage.x[i], storage.y[i], z, storage.width[i], storage.height[i], 0.0f);
+        m_dx[i] = storage.x[i] - storage.px[i];
+        m_dy[i] = storage.y[i] - storage.py[i];
+        m_dz[i] = m_depthCulling ? storage.z[i] - storage.pz[i] : 0.0f;
+    }
+    
+    if(m_boundsResponse) {
+        // the boxes are taken before bouncing, like the behaviors would see
+        // them. Only the classification of the particles is left to do.
+        if(size > 0) {
+            bounceParticles(storage, 0, size, m_bounds, &m_checks[0]);
+        }
+        for(GLuint i = 0; i < size; i++) {
+            if(!storage.collisionEligible[i]) {
+                m_checks[i] = CHECK_NONE;
+            } else if(m_checks[i]) {
+                // bounced, so it may have moved out of the generator's box.
+                generator.extendBoundary(i);
+                m_checks[i] = CHECK_BOUNDS;
+            } else {
+                m_checks[i] = CHECK_PAIRS;
             }
         }
+    } else {
+        for(GLuint i = 0; i < size; i++) {
+            m_checks[i] = classify(storage.x[i], storage.y[i], storage.collisionEligible[i] != 0);
+        }
+    }
+    
+    findFastParticles();
+    findCollisions();
+    findObjectCollisions();
+    if(m_boundsResponse) {
+        m_batch.outOfBounds.clear();
+    } else {
+        fillBatch();
+    }
+    
+    // only the particles which collide are loaded.
+    std::vector<Particle*>& particles = m_batch.particles;
+    particles.assign(size, NULL);
+    m_involved.clear();
+    std::vector<GLuint>::const_iterator out;
+    for(out = m_batch.outOfBounds.begin(); out != m_batch.outOfBounds.end(); out++) {
+        m_involved.push_back(*out);
+    }
+    std::vector<CollisionPair>::const_iterator pair;
+    for(pair = m_batch.pairs.begin(); pair != m_batch.pairs.end(); pair++) {
+        m_involved.push_back(pair->first);
+        m_involved.push_back(pair->second);
+    }
+    std::vector<ObjectCollision>::const_iterator hit;
+    for(hit = m_batch.objects.begin(); hit != m_batch.objects.end(); hit++) {
+        m_involved.push_back(hit->particle);
+    }
+    std::sort(m_involved.begin(), m_involved.end());
+    m_involved.erase(std::unique(m_involved.begin(), m_involved.end()), m_involved.end());
+    
+    m_loaded.resize(m_involved.size());
+    for(GLuint k = 0; k < m_involved.size(); k++) {
+        storage.load(m_involved[k], m_loaded[k]);
+        particles[m_involved[k]] = &m_loaded[k];
+    }
+    
+    fireCollided();
+    
+    for(GLuint k = 0; k < m_involved.size(); k++) {
+        storeParticle(storage, m_involved[k], m_loaded[k]);
+        generator.extendBoundary(m_involved[k]);
     }
 }
 
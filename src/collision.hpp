@@ -20,7 +20,10 @@
 #ifndef COLLISION_HPP
 #define COLLISION_HPP
 
+#include "broadphase.hpp"
 #include "core.hpp"
+#include "jobs.hpp"
+#include "tree.hpp"
 
 #include <GL/gl.h>
 #include <iostream>
@@ -29,9 +32,116 @@
 
 namespace ogle {
 
+/**
+ * Sweeps a box along a displacement against another box which stays in place,
+ * to find collisions a test at the end of the move would miss, like a fast
+ * particle passing through a thin box. Boxes which touch count as hitting, 
+ * like with Rect::intersects(). To sweep two moving boxes against each other,
+ * sweep one with the difference of their displacements.
+ * 
+ * @param box The moving box, at the start of the move.
+ * @param dx The displacement on the x-axis.
+ * @param dy The displacement on the y-axis.
+ * @param target The box to sweep against.
+ * @param time Set to the time of impact when the boxes hit, from 0.0f at the
+ *   start to 1.0f at the end of the move.
+ * @return true when the boxes hit during the move.
+ */
+bool sweepRects(const Rect& box, const GLfloat& dx, const GLfloat& dy, const Rect& target, GLfloat& time);
+
+/**
+ * Gets the box covering a box along the whole of a displacement.
+ * 
+ * @param box The moving box, at the start of the move.
+ * @param dx The displacement on the x-axis.
+ * @param dy The displacement on the y-axis.
+ * @return The box covering the move, with a positive width and height.
+ */
+Rect sweptRect(const Rect& box, const GLfloat& dx, const GLfloat& dy);
+
+/**
+ * Sweeps a box along a displacement in three dimensions, like sweepRects().
+ * 
+ * @param box The moving box, at the start of the move.
+ * @param dx The displacement on the x-axis.
+ * @param dy The displacement on the y-axis.
+ * @param dz The displacement on the z-axis.
+ * @param target The box to sweep against.
+ * @param time Set to the time of impact when the boxes hit.
+ * @return true when the boxes hit during the move.
+ */
+bool sweepBoxes(const AABB3& box, const GLfloat& dx, const GLfloat& dy, const GLfloat& dz, 
+        const AABB3& target, GLfloat& time);
+
+/**
+ * Gets the box covering a box along the whole of a displacement in three 
+ * dimensions, like sweptRect().
+ */
+AABB3 sweptBox(const AABB3& box, const GLfloat& dx, const GLfloat& dy, const GLfloat& dz);
+
+//==============================================================================
+
+/**
+ * A particle colliding with an object of the geometry of a CollisionDetector.
+ */
+struct ObjectCollision {
+    /// Index of the particle.
+    GLuint particle;
+    
+    /// The object.
+    Object* object;
+};
+
+//==============================================================================
+
+/**
+ * All collisions found by a single check of a CollisionDetector.
+ */
+class CollisionBatch {
+public:
+    CollisionBatch();
+    
+    ~CollisionBatch();
+    
+    /// The checked particles, by index. Only the particles which are part of a
+    /// collision are guaranteed to be set, the others may be NULL.
+    std::vector<Particle*> particles;
+    
+    /// Particles which collided with each other, sorted.
+    std::vector<CollisionPair> pairs;
+    
+    /// Particles which are out of bounds, sorted.
+    std::vector<GLuint> outOfBounds;
+    
+    /// Particles colliding with the geometry, sorted by particle.
+    std::vector<ObjectCollision> objects;
+    
+    /// The bounds of the detector.
+    Rect bounds;
+    
+    /**
+     * Empties the batch.
+     */
+    void clear();
+    
+    /**
+     * Checks whether there are any collisions.
+     * 
+     * @return true when there are none.
+     */
+    bool empty() const;
+};
+
+//==============================================================================
+
 /**
  * Class to describe behavior of particles after collision happened. This is a
  * base class which can be extended for other types of behavior.
+ * 
+ * The detector hands all collisions of a check to collided() at once. By 
+ * default, that calls particlesCollided() and boundsCollided() for every 
+ * collision, so subclasses can either handle single collisions, or override 
+ * collided() to handle them all in a single loop.
  */
 class CollisionBehavior {
 public:
@@ -39,9 +149,70 @@ public:
     
     virtual ~CollisionBehavior();
     
-    void particlesCollided(Particle* const one, Particle* const two);
+    /**
+     * Handles the collisions of a single check. By default, calls 
+     * boundsCollided() and particlesCollided() for every collision, ordered by
+     * the index of the (first) particle, followed by objectCollided() for
+     * every collision with the geometry.
+     * 
+     * @param batch The collisions.
+     */
+    virtual void collided(const CollisionBatch& batch);
+    
+    /**
+     * Handles two particles colliding. Does nothing by default.
+     */
+    virtual void particlesCollided(Particle* const one, Particle* const two);
+    
+    /**
+     * Handles a particle going out of bounds. By default, bounces off the 
+     * sides, and stops at the bottom and top.
+     */
+    virtual void boundsCollided(Particle* const particle, const Rect& bounds);
+    
+    /**
+     * Handles a particle colliding with an object of the geometry. Does 
+     * nothing by default.
+     */
+    virtual void objectCollided(Particle* const particle, Object* const object);
+};
+
+//==============================================================================
+
+class CollisionDetector;
+
+/**
+ * A part of the pair tests of a CollisionDetector, executed as a single job.
+ * Every job collects the colliding pairs it finds in its own buffer, so jobs 
+ * can run in parallel without locking.
+ */
+class CollisionJob : public Job {
+public:
+    /**
+     * Creates the job.
+     * 
+     * @param detector The detector to test pairs for.
+     */
+    CollisionJob(CollisionDetector* const detector = NULL);
+    
+    ~CollisionJob();
+    
+    /// The detector to test pairs for.
+    CollisionDetector* detector;
+    
+    /// The first candidate pair to test, or the first particle when testing all pairs.
+    GLuint begin;
+    
+    /// One past the last candidate pair or particle.
+    GLuint end;
     
-    void boundsCollided(Particle* const particle, const Rect& bounds);
+    /// The colliding pairs found, sorted when testing all pairs.
+    std::vector<CollisionPair> pairs;
+    
+    /**
+     * Tests the pairs of this job.
+     */
+    virtual void execute();
 };
 
 //==============================================================================
@@ -59,17 +230,126 @@ private:
     /// Vector with behaviors.
     std::vector<CollisionBehavior*> m_behaviors;
     
-    void fireParticlesCollided(Particle* const one, Particle* const two);
+    /// The broadphase to find candidate pairs with, or NULL to test all pairs.
+    Broadphase* m_broadphase;
+    
+    /// Boundaries of the particles being checked, flat at z = 0 when not 
+    /// culling along the z-axis.
+    std::vector<AABB3> m_boxes;
+    
+    /// Displacement of the particles on the x-axis during their last step.
+    std::vector<GLfloat> m_dx;
+    
+    /// Displacement of the particles on the y-axis during their last step.
+    std::vector<GLfloat> m_dy;
+    
+    /// Displacement of the particles on the z-axis, or 0 when not culling.
+    std::vector<GLfloat> m_dz;
+    
+    /// Whether each particle moved further than its size, see setContinuous().
+    std::vector<GLubyte> m_fast;
+    
+    /// Boxes covering the moves of the particles, for the broadphase.
+    std::vector<AABB3> m_swept;
     
-    void fireBoundsCollided(Particle* const particle, const Rect& rect);
+    /// The amount of fast particles in m_fast.
+    GLuint m_fastCount;
+    
+    /// Whether to sweep fast particles.
+    bool m_continuous;
+    
+    /// Whether to test the particles along the z-axis too.
+    bool m_depthCulling;
+    
+    /// What to check for every particle, see checkCollisions().
+    std::vector<GLubyte> m_checks;
+    
+    /// Candidate pairs found by the broadphase.
+    std::vector<CollisionPair> m_candidates;
+    
+    /// The pool to test pairs on, or NULL to test them on the calling thread.
+    JobPool* m_pool;
+    
+    /// Jobs testing the pairs, kept to reuse their buffers.
+    std::vector<CollisionJob> m_jobs;
+    
+    /// Whether to apply the default bounds response to generators directly.
+    bool m_boundsResponse;
+    
+    /// Objects to collide the particles with, or NULL.
+    DynamicTree* m_geometry;
+    
+    /// Objects found for a single particle.
+    std::vector<Object*> m_hits;
+    
+    /// The collisions handed to the behaviors.
+    CollisionBatch m_batch;
+    
+    /// Generator particles which are part of a collision, by their index.
+    std::vector<GLuint> m_involved;
+    
+    /// Copies of the generator particles in m_involved, for the behaviors.
+    std::vector<Particle> m_loaded;
+    
+    /**
+     * Hands the batch to every behavior.
+     */
+    void fireCollided();
+    
+    /**
+     * Checks the particles set in the batch.
+     */
+    void checkParticles();
+    
+    /**
+     * Fills the particles out of bounds of the batch, given m_checks.
+     */
+    void fillBatch();
+    
+    /**
+     * Fills the object collisions of the batch, given m_boxes and m_checks.
+     */
+    void findObjectCollisions();
+    
+    /**
+     * Classifies a particle, see ParticleCheck in the implementation.
+     */
+    GLubyte classify(const GLfloat& x, const GLfloat& y, bool eligible) const;
+    
+    /**
+     * Fills m_fast and m_swept, given m_boxes, m_dx and m_dy.
+     */
+    void findFastParticles();
+    
+    /**
+     * Tests whether two particles collide, sweeping them when either is fast.
+     */
+    bool collides(const GLuint& i, const GLuint& j) const;
+    
+    /**
+     * Fills the pairs of the batch with the colliding pairs of m_boxes, given
+     * m_checks.
+     */
+    void findCollisions();
+    
+    /**
+     * Tests the pairs of a single job.
+     * 
+     * @param job The job.
+     */
+    void testPairs(CollisionJob& job) const;
+    
+    friend class CollisionJob;
     
 public:
     /**
      * Creates the CollisionDetector with the specified bounds.
      * 
      * @param The bounds of the plane.
+     * @param broadphase The broadphase to find candidate pairs with, or NULL
+     *   to test every pair. The detector does not take ownership.
      */
-    CollisionDetector(const Rect& bounds);
+    CollisionDetector(const Rect& bounds, Broadphase* const broadphase = NULL);
     
     /**
      * Destroys the collision detector.
@@ -83,12 +363,113 @@ public:
      */
     void addBehavior(CollisionBehavior* const behavior);
     
+    /**
+     * Sets a pool to test the pairs on in parallel. The behaviors are still
+     * called from the calling thread, after all pairs are tested, in the same
+     * order as without a pool. So behaviors need not be thread safe, and the
+     * results do not depend on the amount of threads.
+     * 
+     * @param pool The pool, or NULL to test on the calling thread only. The
+     *   detector does not take ownership.
+     */
+    void setJobPool(JobPool* const pool);
+    
+    JobPool* getJobPool() const;
+    
+    /**
+     * Sets whether checkCollisions(ParticleGenerator&) applies the default 
+     * response of CollisionBehavior::boundsCollided() itself, to all particles
+     * out of bounds at once using bounceParticles(). The behaviors then only 
+     * receive the particle collisions, and the particles out of bounds have 
+     * already been bounced when they're called. Defaults to false.
+     * 
+     * Use this instead of a behavior with the default boundsCollided(), not
+     * along with it, or the particles bounce twice.
+     * 
+     * @param apply true to apply the default bounds response.
+     */
+    void setBoundsResponse(bool apply);
+    
+    bool isBoundsResponse() const;
+    
+    /**
+     * Sets the geometry to collide the particles with, like the static boxes
+     * of a level. Every particle which is eligible and in bounds is tested 
+     * against the objects in the tree, which only takes <code>O(log n)</code>
+     * per particle. The collisions end up in CollisionBatch::objects.
+     * 
+     * @param geometry The tree with the objects, or NULL for none. The 
+     *   detector does not take ownership.
+     */
+    void setGeometry(DynamicTree* const geometry);
+    
+    DynamicTree* getGeometry() const;
+    
+    /**
+     * Sets whether particles which moved further than their own size during 
+     * their last step are swept along that move, against the other particles
+     * and the geometry, using sweepRects(). Otherwise a fast particle may pass
+     * through another particle or a thin object between two checks, without
+     * ever overlapping it. Defaults to true.
+     * 
+     * The move of a generator particle is taken from its previous position in
+     * the ParticleStorage. The move of a Particle object is taken from its 
+     * velocity, before gravity was added. The bounds need no sweeping, since 
+     * a particle which passed them is still out of bounds.
+     * 
+     * With depth culling, a particle is also fast when it moved further along
+     * the z-axis than its width or height, since it has no depth of its own.
+     * 
+     * @param continuous true to sweep fast particles.
+     */
+    void setContinuous(bool continuous);
+    
+    bool isContinuous() const;
+    
+    /**
+     * Sets whether the particles and the geometry are tested in three 
+     * dimensions, using AABB3 and the 3D variant of Broadphase::findPairs(), so
+     * pairs at different depths are culled before the behaviors see them. 
+     * Particles are flat, like the quads they're drawn as, so two particles 
+     * only collide at the same depth, or when they cross each other's depth 
+     * while sweeping. Objects of the geometry use Object::getBoundary3D(). 
+     * The bounds remain two-dimensional. Defaults to false, so everything is
+     * taken to be on the xy plane.
+     * 
+     * @param culling true to test along the z-axis.
+     */
+    void setDepthCulling(bool culling);
+    
+    bool isDepthCulling() const;
+    
     /**
      * Checks for collisions in the given particle vector. Since it's a one
      * dimensional array of Particle* objects, this will do internal comparisons.
-     * This will run in a complexity of <code>O(n - 1)</code>.
+     * Without a broadphase every pair is tested, which runs in a complexity of
+     * <code>O(n^2)</code>. With a broadphase only the candidate pairs are
+     * tested. Either way, all collisions are found before the behaviors are 
+     * called, one behavior after the other, with all the collisions at once.
+     */
+    void checkCollisions(const std::vector<Particle*>& particles);
+    
+    /**
+     * Checks for collisions in an array of particles, like the vector version
+     * but without the need to collect pointers. After the first call, no memory
+     * is allocated unless the amount of particles or collisions grows.
+     * 
+     * @param particles The first particle of the array.
+     * @param count The amount of particles in the array.
+     */
+    void checkCollisions(Particle* const particles, const GLuint& count);
+    
+    /**
+     * Checks for collisions between the live particles of a generator, reading
+     * its ParticleStorage directly. Only the particles which collide are 
+     * copied to Particle objects for the behaviors, and stored back after. 
+     * 
+     * @param generator The generator.
      */
-    void checkCollisions(std::vector<Particle*> particles);
+    void checkCollisions(ParticleGenerator& generator);
 };
 
 } // namespace ogle
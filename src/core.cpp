@@ -18,7 +18,12 @@
 //      MA 02110-1301, USA.
 
 #include "core.hpp"
+#include "simd.hpp"
 #include "utils.hpp"
+#include "vec3.hpp"
+
+#include <cfloat>
+#include <cstring>
 
 namespace ogle {
 
@@ -98,13 +103,122 @@ bool Rect::intersects(const Rect& rect) const {
 
 //==============================================================================
 
+AABB3::AABB3(const GLfloat& x, const GLfloat& y, const GLfloat& z, 
+             const GLfloat& w, const GLfloat& h, const GLfloat& d) {
+    this->x = x;
+    this->y = y;
+    this->z = z;
+    this->w = w;
+    this->h = h;
+    this->d = d;
+}
+
+AABB3::AABB3(const Rect& rect, const GLfloat& z, const GLfloat& d) {
+    this->x = rect.x;
+    this->y = rect.y;
+    this->z = z;
+    this->w = rect.w;
+    this->h = rect.h;
+    this->d = d;
+}
+
+AABB3::~AABB3() {
+}
+
+bool AABB3::intersects(const AABB3& box) const {
+    return (x + w) >= box.x && x <= box.x + box.w &&
+           (y + h) >= box.y && y <= box.y + box.h &&
+           (z + d) >= box.z && z <= box.z + box.d;
+}
+
+Rect AABB3::getRect() const {
+    return Rect(x, y, w, h);
+}
+
+//==============================================================================
+
+RenderState::RenderState() :
+        pass(PASS_OPAQUE),
+        lighting(true),
+        blending(false),
+        srcBlend(GL_ONE),
+        dstBlend(GL_ZERO),
+        material(false),
+        frontFace(GL_CCW) {
+}
+
+RenderState::~RenderState() {
+}
+
+bool RenderState::operator==(const RenderState& other) const {
+    // the blend function and material only matter when they are used.
+    if(pass != other.pass || lighting != other.lighting || blending != other.blending ||
+       material != other.material || frontFace != other.frontFace) {
+        return false;
+    }
+    if(blending && (srcBlend != other.srcBlend || dstBlend != other.dstBlend)) {
+        return false;
+    }
+    if(material && (color.getR() != other.color.getR() || color.getG() != other.color.getG() ||
+                    color.getB() != other.color.getB() || color.getA() != other.color.getA())) {
+        return false;
+    }
+    return true;
+}
+
+bool RenderState::operator!=(const RenderState& other) const {
+    return !(*this == other);
+}
+
+bool RenderState::operator<(const RenderState& other) const {
+    if(pass != other.pass) {
+        return pass < other.pass;
+    }
+    if(lighting != other.lighting) {
+        return other.lighting;
+    }
+    if(blending != other.blending) {
+        return other.blending;
+    }
+    if(material != other.material) {
+        return other.material;
+    }
+    if(frontFace != other.frontFace) {
+        return frontFace < other.frontFace;
+    }
+    if(blending) {
+        if(srcBlend != other.srcBlend) {
+            return srcBlend < other.srcBlend;
+        }
+        if(dstBlend != other.dstBlend) {
+            return dstBlend < other.dstBlend;
+        }
+    }
+    if(material) {
+        if(color.getR() != other.color.getR()) {
+            return color.getR() < other.color.getR();
+        }
+        if(color.getG() != other.color.getG()) {
+            return color.getG() < other.color.getG();
+        }
+        if(color.getB() != other.color.getB()) {
+            return color.getB() < other.color.getB();
+        }
+        return color.getA() < other.color.getA();
+    }
+    return false;
+}
+
+//==============================================================================
+
 Object::Object(const GLfloat& x, const GLfloat& y, const GLfloat& z) :
         m_x(x), 
         m_y(y), 
         m_z(z), 
         m_width(1.0f), 
         m_height(1.0f),
-        m_collisionEligible(true) {
+        m_collisionEligible(true),
+        m_dirty(true) {
 }
 
 Object::~Object() {
@@ -114,26 +228,32 @@ void Object::setPosition(const GLfloat& x, const GLfloat& y, const GLfloat& z) {
     m_x = x;
     m_y = y;
     m_z = z;
+    m_dirty = true;
 }
 
 void Object::setX(const GLfloat& x) {
     m_x = x;
+    m_dirty = true;
 }
 
 void Object::setY(const GLfloat& y) {
     m_y = y;
+    m_dirty = true;
 }
 
 void Object::setZ(const GLfloat& z) {
     m_z = z;
+    m_dirty = true;
 }
 
 void Object::setWidth(const GLfloat& w) {
     m_width = w;
+    m_dirty = true;
 }
 
 void Object::setHeight(const GLfloat& h) {
     m_height = h;
+    m_dirty = true;
 }
 
 void Object::setCollisionEligible(bool eligible) {
@@ -168,23 +288,51 @@ const Rect& Object::getBoundary() {
     return m_boundaryBox;   
 }
 
+const AABB3& Object::getBoundary3D() {
+    m_boundaryBox3D = AABB3(m_x, m_y, m_z, m_width, m_height, 0.0f);
+    return m_boundaryBox3D;
+}
+
 bool Object::isCollisionEligible() const {
     return m_collisionEligible;
 }
 
+void Object::setRenderState(const RenderState& state) {
+    m_renderState = state;
+}
+
+const RenderState& Object::getRenderState() const {
+    return m_renderState;
+}
+
+void Object::draw() {
+    render();
+}
+
 //==============================================================================
 
 Axis::Axis(const GLfloat& max) :
         m_max(max) {
+    m_renderState.lighting = false;
 }
 
 Axis::~Axis() {
 }
 
+const AABB3& Axis::getBoundary3D() {
+    m_boundaryBox3D = AABB3(-m_max, -m_max, -m_max, 2.0f * m_max, 2.0f * m_max, 2.0f * m_max);
+    return m_boundaryBox3D;
+}
+
 void Axis::render() {
     // this axis does not have a material, nor does lighting have an effect on
     // the appearance of this axis.
     glDisable(GL_LIGHTING);
+    draw();
+    glEnable(GL_LIGHTING);
+}
+
+void Axis::draw() {
     glBegin(GL_LINES);
         // draw the main axis here in green
         glColor4f(0.0f, 1.0f, 0.0f, 1.0f); 
@@ -194,7 +342,6 @@ void Axis::render() {
         glColor4f(1.0f, 0.0f, 1.0f, 1.0f); 
         glVertex3f(0.0f, 0.0f, -m_max); glVertex3f(0.0f, 0.0f, m_max); // z-axis, cyan
     glEnd();
-    glEnable(GL_LIGHTING);
 }
 
 //==============================================================================
@@ -202,62 +349,148 @@ void Axis::render() {
 Box::Box() :
         Object(0.0f, 0.0f, 0.0f),
         m_depth(1.0f) {
+    m_geometry.setUsage(GL_STATIC_DRAW);
+    m_renderState.material = true;
+    m_renderState.color = Color(1.0f, 0.0f, 0.0f, 1.0f);
+}
+
+Box::Box(const Box& other) :
+        Object(other),
+        m_depth(other.m_depth),
+        m_geometry(other.m_geometry) {
+    m_dirty = true;
 }
 
 Box::~Box() {
 }
 
+Box& Box::operator=(const Box& other) {
+    Object::operator=(other);
+    m_depth = other.m_depth;
+    m_dirty = true;
+    return *this;
+}
+
+void Box::setDepth(const GLfloat& depth) {
+    m_depth = depth;
+    m_dirty = true;
+}
+
+const GLfloat& Box::getDepth() const {
+    return m_depth;
+}
+
+const AABB3& Box::getBoundary3D() {
+    m_boundaryBox3D = AABB3(m_x, m_y, m_z, m_width, m_height, m_depth);
+    return m_boundaryBox3D;
+}
+
+/// Floats per vertex of the box geometry: the position followed by the normal.
+static const GLuint BOX_VERTEX_FLOATS = 6;
+
+/// Vertices of the box geometry: six quads.
+static const GLuint BOX_VERTICES = 24;
+
+/**
+ * Writes a vertex of the box geometry, and moves on to the next one.
+ */
+static void putVertex(GLfloat*& out, const GLfloat& x, const GLfloat& y, const GLfloat& z, const Vec3& normal) {
+    out[0] = x;
+    out[1] = y;
+    out[2] = z;
+    out[3] = normal.x;
+    out[4] = normal.y;
+    out[5] = normal.z;
+    out += BOX_VERTEX_FLOATS;
+}
+
+bool Box::buildGeometry() {
+    GLfloat* out = static_cast<GLfloat*>(m_geometry.map(BOX_VERTICES * BOX_VERTEX_FLOATS * sizeof(GLfloat)));
+    if(out == NULL) {
+        return false;
+    }
+    
+    const GLfloat x1 = m_x;
+    const GLfloat y1 = m_y;
+    const GLfloat z1 = m_z;
+    const GLfloat x2 = m_x + m_width;
+    const GLfloat y2 = m_y + m_height;
+    const GLfloat z2 = m_z + m_depth;
+    
+    // faces are rendered counter clockwise, starting 'top-right'. The normals
+    // point outwards along the axes and don't depend on the size.
+    // 'front' face
+    const Vec3 front = -UNIT_Z;
+    putVertex(out, x2, y2, z1, front);
+    putVertex(out, x1, y2, z1, front);
+    putVertex(out, x1, y1, z1, front);
+    putVertex(out, x2, y1, z1, front);
+    // 'back' face
+    const Vec3 back = UNIT_Z;
+    putVertex(out, x2, y2, z2, back);
+    putVertex(out, x1, y2, z2, back);
+    putVertex(out, x1, y1, z2, back);
+    putVertex(out, x2, y1, z2, back);
+    // 'top' face
+    const Vec3 top = UNIT_Y;
+    putVertex(out, x2, y2, z2, top);
+    putVertex(out, x1, y2, z2, top);
+    putVertex(out, x1, y2, z1, top);
+    putVertex(out, x2, y2, z1, top);
+    // 'bottom' face
+    const Vec3 bottom = -UNIT_Y;
+    putVertex(out, x2, y1, z2, bottom);
+    putVertex(out, x1, y1, z2, bottom);
+    putVertex(out, x1, y1, z1, bottom);
+    putVertex(out, x2, y1, z1, bottom);
+    // 'left' face
+    const Vec3 left = -UNIT_X;
+    putVertex(out, x1, y1, z1, left);
+    putVertex(out, x1, y2, z1, left);
+    putVertex(out, x1, y2, z2, left);
+    putVertex(out, x1, y1, z2, left);
+    // 'right' face
+    const Vec3 right = UNIT_X;
+    putVertex(out, x2, y1, z1, right);
+    putVertex(out, x2, y2, z1, right);
+    putVertex(out, x2, y2, z2, right);
+    putVertex(out, x2, y1, z2, right);
+    
+    // when the upload failed, the box stays dirty so it's built again.
+    if(!m_geometry.unmap()) {
+        return false;
+    }
+    m_dirty = false;
+    return true;
+}
+
 void Box::render() {
-    // faces are rendered counter clockwise, starting 'top-right'.
-    float mcolor[] = { 1.0f, 0.0f, 0.0f, 1.0f };
+    const Color& color = m_renderState.color;
+    const GLfloat mcolor[] = { color.getR(), color.getG(), color.getB(), color.getA() };
     glMaterialfv(GL_FRONT, GL_AMBIENT_AND_DIFFUSE, mcolor);
     // front faces are counter-clockwise
     glFrontFace(GL_CCW);
-    glBegin(GL_QUADS);
-        // 'front' face
-        Vertex a(getX() + getWidth(), getY() + getHeight(), getZ());
-        Vertex b(getX(), getY() + getHeight(), getZ());
+    draw();
+}
 
-        Vertex n1 = Vertex::calcNormal(a,b);
-        n1.normalize();
-        glNormal3f(n1.x, n1.y, n1.z);
-        
-        glVertex3f(getX() + getWidth(), getY() + getHeight(), getZ());
-        glVertex3f(getX(), getY() + getHeight(), getZ());
-        glVertex3f(getX(), getY(), getZ());
-        glVertex3f(getX() + getWidth(), getY(), getZ());
-        // 'back' face
-        glNormal3f(0.0f, 0.0f, -1.0f);
-        glVertex3f(getX() + getWidth(), getY() + getHeight(), getZ() + m_depth);
-        glVertex3f(getX(), getY() + getHeight(), getZ() + m_depth);
-        glVertex3f(getX(), getY(), getZ() + m_depth);
-        glVertex3f(getX() + getWidth(), getY(), getZ() + m_depth);
-        // 'top' face
-        glNormal3f(0.0f, 1.0f, 0.0f);
-        glVertex3f(getX() + getWidth(), getY() + getHeight(), getZ() + m_depth);
-        glVertex3f(getX(), getY() + getHeight(), getZ() + m_depth);
-        glVertex3f(getX(), getY() + getHeight(), getZ());
-        glVertex3f(getX() + getWidth(), getY() + getHeight(), getZ());
-        // 'bottom' face
-        glNormal3f(0.0f, -1.0f, 0.0f);
-        glVertex3f(getX() + getWidth(), getY(), getZ() + m_depth);
-        glVertex3f(getX(), getY(), getZ() + m_depth);
-        glVertex3f(getX(), getY(), getZ());
-        glVertex3f(getX() + getWidth(), getY(), getZ());
-        // 'left' face
-        glNormal3f(-1.0f, 0.0f, 0.0f);
-        glVertex3f(getX(), getY(), getZ());
-        glVertex3f(getX(), getY() + getHeight(), getZ());
-        glVertex3f(getX(), getY() + getHeight(), getZ() + m_depth);
-        glVertex3f(getX(), getY(), getZ() + m_depth);
-        // 'right' face
-        glNormal3f(1.0f, 0.0f, 0.0f);
-        glVertex3f(getX() + getWidth(), getY(), getZ());
-        glVertex3f(getX() + getWidth(), getY() + getHeight(), getZ());
-        glVertex3f(getX() + getWidth(), getY() + getHeight(), getZ() + m_depth);
-        glVertex3f(getX() + getWidth(), getY(), getZ() + m_depth);
-        
-    glEnd();
+void Box::draw() {
+    if(!m_dirty) {
+        m_geometry.bind();
+    } else if(!buildGeometry()) {
+        m_geometry.unbind();
+        return;
+    }
+    
+    const GLsizei stride = BOX_VERTEX_FLOATS * sizeof(GLfloat);
+    const GLubyte* base = m_geometry.getPointer();
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glVertexPointer(3, GL_FLOAT, stride, base);
+    glNormalPointer(GL_FLOAT, stride, base + 3 * sizeof(GLfloat));
+    glDrawArrays(GL_QUADS, 0, BOX_VERTICES);
+    glDisableClientState(GL_NORMAL_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    m_geometry.unbind();
 }
 
 //==============================================================================
@@ -354,12 +587,366 @@ void Particle::render() {
 
 //==============================================================================
 
+ParticleStorage::ParticleStorage() :
+        m_size(0) {
+}
+
+ParticleStorage::~ParticleStorage() {
+}
+
+void ParticleStorage::resize(const GLuint& size) {
+    // new particles get the same defaults as a freshly constructed particle.
+    const Particle p;
+    const Color c = p.getColor();
+    x.resize(size, p.getX());
+    y.resize(size, p.getY());
+    z.resize(size, p.getZ());
+    px.resize(size, p.getX());
+    py.resize(size, p.getY());
+    pz.resize(size, p.getZ());
+    xv.resize(size, p.getXv());
+    yv.resize(size, p.getYv());
+    zv.resize(size, p.getZv());
+    life.resize(size, p.getLife());
+    gravity.resize(size, p.getGravity());
+    fade.resize(size, p.getFadeSpeed());
+    r.resize(size, c.getR());
+    g.resize(size, c.getG());
+    b.resize(size, c.getB());
+    a.resize(size, c.getA());
+    width.resize(size, p.getWidth());
+    height.resize(size, p.getHeight());
+    active.resize(size, p.isActive());
+    collisionEligible.resize(size, p.isCollisionEligible());
+    m_size = size;
+}
+
+const GLuint& ParticleStorage::getSize() const {
+    return m_size;
+}
+
+void ParticleStorage::copy(const GLuint& from, const GLuint& to) {
+    x[to]       = x[from];
+    y[to]       = y[from];
+    z[to]       = z[from];
+    px[to]      = px[from];
+    py[to]      = py[from];
+    pz[to]      = pz[from];
+    xv[to]      = xv[from];
+    yv[to]      = yv[from];
+    zv[to]      = zv[from];
+    life[to]    = life[from];
+    gravity[to] = gravity[from];
+    fade[to]    = fade[from];
+    r[to]       = r[from];
+    g[to]       = g[from];
+    b[to]       = b[from];
+    a[to]       = a[from];
+    width[to]   = width[from];
+    height[to]  = height[from];
+    active[to]  = active[from];
+    collisionEligible[to] = collisionEligible[from];
+}
+
+void ParticleStorage::load(const GLuint& i, Particle& p) const {
+    p.setPosition(x[i], y[i], z[i]);
+    p.setXv(xv[i]);
+    p.setYv(yv[i]);
+    p.setZv(zv[i]);
+    p.setLife(life[i]);
+    p.setGravity(gravity[i]);
+    p.setFadeSpeed(fade[i]);
+    p.setColor(Color(r[i], g[i], b[i], a[i]));
+    p.setWidth(width[i]);
+    p.setHeight(height[i]);
+    p.setActive(active[i] != 0);
+    p.setCollisionEligible(collisionEligible[i] != 0);
+}
+
+void ParticleStorage::store(const GLuint& i, const Particle& p) {
+    const Color c = p.getColor();
+    x[i]       = p.getX();
+    y[i]       = p.getY();
+    z[i]       = p.getZ();
+    px[i]      = x[i];
+    py[i]      = y[i];
+    pz[i]      = z[i];
+    xv[i]      = p.getXv();
+    yv[i]      = p.getYv();
+    zv[i]      = p.getZv();
+    life[i]    = p.getLife();
+    gravity[i] = p.getGravity();
+    fade[i]    = p.getFadeSpeed();
+    r[i]       = c.getR();
+    g[i]       = c.getG();
+    b[i]       = c.getB();
+    a[i]       = c.getA();
+    width[i]   = p.getWidth();
+    height[i]  = p.getHeight();
+    active[i]  = p.isActive() ? 1 : 0;
+    collisionEligible[i] = p.isCollisionEligible() ? 1 : 0;
+}
+
+//==============================================================================
+
+ParticleBurst::ParticleBurst(const double& t, const GLuint& c, const double& i) :
+        time(t), 
+        count(c), 
+        interval(i) {
+}
+
+ParticleBurst::~ParticleBurst() {
+}
+
+GLuint ParticleBurst::occurrences(const double& from, const double& to) const {
+    if(to <= time) {
+        return 0;
+    }
+    if(interval <= 0.0) {
+        return from <= time ? 1 : 0;
+    }
+    // bursts happen at time + k * interval; count the k's within [from, to).
+    double first = from <= time ? 0.0 : ceil((from - time) / interval);
+    double last  = ceil((to - time) / interval);
+    return last > first ? static_cast<GLuint>(last - first) : 0;
+}
+
+//==============================================================================
+
+/// Random number generator of the chunk being simulated on this thread, if any.
+static OGLE_THREAD_LOCAL Random* s_chunkRandom = NULL;
+
+/// Set while probeInitParticle() calls initParticle() on this thread, so the 
+/// default implementation leaves the particle alone.
+static OGLE_THREAD_LOCAL bool s_probing = false;
+
+/// Set when the default initParticle() was reached while probing.
+static OGLE_THREAD_LOCAL bool s_probed = false;
+
+/**
+ * Indices of a range of particles, for spawnParticles().
+ */
+struct RangeIndex {
+    GLuint begin;
+    
+    RangeIndex(const GLuint& b) : begin(b) {
+    }
+    
+    GLuint operator[](const GLuint& k) const {
+        return begin + k;
+    }
+};
+
+/**
+ * Initializes particles straight in the storage, the same way as the default
+ * ParticleGenerator::initParticle() does. The k-th particle is at index[k],
+ * and takes the k-th number of each of the arrays of random numbers.
+ */
+template <typename INDEX>
+static void spawnParticles(ParticleStorage& storage, const INDEX& index, const GLuint& count,
+                           const GLfloat* dx, const GLfloat* dy, const GLfloat* dz, 
+                           const GLfloat* gv, const GLfloat* fs,
+                           const GLfloat& originX, const GLfloat& originY, const GLfloat& particleLife) {
+    // grab the arrays once, so the loop below does not go through the vectors.
+    GLfloat* x  = &storage.x[0];
+    GLfloat* y  = &storage.y[0];
+    GLfloat* z  = &storage.z[0];
+    GLfloat* px = &storage.px[0];
+    GLfloat* py = &storage.py[0];
+    GLfloat* pz = &storage.pz[0];
+    GLfloat* xv = &storage.xv[0];
+    GLfloat* yv = &storage.yv[0];
+    GLfloat* zv = &storage.zv[0];
+    GLfloat* gravity = &storage.gravity[0];
+    GLfloat* fade = &storage.fade[0];
+    GLfloat* life = &storage.life[0];
+    GLclampf* r = &storage.r[0];
+    GLclampf* g = &storage.g[0];
+    GLclampf* b = &storage.b[0];
+    GLclampf* a = &storage.a[0];
+    GLubyte* active = &storage.active[0];
+    GLubyte* eligible = &storage.collisionEligible[0];
+    
+    for(GLuint k = 0; k < count; k++) {
+        const GLuint i = index[k];
+        // the random arrays may be the velocity arrays themselves.
+        const GLfloat vx = dx[k], vy = dy[k];
+        x[i]  = px[i] = originX + vx;
+        y[i]  = py[i] = originY + vy;
+        z[i]  = pz[i] = 0.0f;
+        xv[i] = vx;
+        yv[i] = vy;
+        zv[i] = dz[k];
+        gravity[i] = gv[k];
+        fade[i]    = fs[k];
+        life[i]    = particleLife;
+        r[i] = g[i] = b[i] = a[i] = 1.0f;
+        active[i]   = 1;
+        eligible[i] = 1;
+    }
+}
+
+/**
+ * Grows a box, given as the minimum x, y, z followed by the maximum x, y, z,
+ * to include another one.
+ */
+static void mergeBounds(GLfloat* bounds, bool& found, const GLfloat* other) {
+    if(!found) {
+        std::copy(other, other + 6, bounds);
+        found = true;
+        return;
+    }
+    for(GLuint k = 0; k < 3; k++) {
+        bounds[k]     = std::min(bounds[k],     other[k]);
+        bounds[k + 3] = std::max(bounds[k + 3], other[k + 3]);
+    }
+}
+
+/**
+ * Gets the box around the live particles in the range [begin, end) of the 
+ * storage, as for mergeBounds(). When interpolating, the positions before the
+ * last step are included, since the particles are rendered in between.
+ * 
+ * @return Whether there were live particles in the range.
+ */
+template <bool INTERPOLATE>
+static bool boundParticles(GLfloat* bounds, const ParticleStorage& storage, const GLuint& begin, const GLuint& end) {
+    const GLfloat* x  = &storage.x[0];
+    const GLfloat* y  = &storage.y[0];
+    const GLfloat* z  = &storage.z[0];
+    const GLfloat* px = &storage.px[0];
+    const GLfloat* py = &storage.py[0];
+    const GLfloat* pz = &storage.pz[0];
+    const GLfloat* life = &storage.life[0];
+    const GLfloat* w = &storage.width[0];
+    const GLfloat* h = &storage.height[0];
+    const GLubyte* active = &storage.active[0];
+    
+    GLfloat minX = FLT_MAX, minY = FLT_MAX, minZ = FLT_MAX;
+    GLfloat maxX = -FLT_MAX, maxY = -FLT_MAX, maxZ = -FLT_MAX;
+    GLuint live = 0;
+    for(GLuint i = begin; i < end; i++) {
+        // same check as renderImmediate(). Dead particles get an empty box, 
+        // without branching, so the loop can be vectorized.
+        const bool alive = life[i] > 0.0f && active[i];
+        live += alive ? 1 : 0;
+        GLfloat x1 = x[i], y1 = y[i], z1 = z[i];
+        GLfloat x2 = x1, y2 = y1, z2 = z1;
+        if(INTERPOLATE) {
+            x1 = std::min(x1, px[i]); x2 = std::max(x2, px[i]);
+            y1 = std::min(y1, py[i]); y2 = std::max(y2, py[i]);
+            z1 = std::min(z1, pz[i]); z2 = std::max(z2, pz[i]);
+        }
+        minX = std::min(minX, alive ? x1 : FLT_MAX); maxX = std::max(maxX, alive ? x2 + w[i] : -FLT_MAX);
+        minY = std::min(minY, alive ? y1 : FLT_MAX); maxY = std::max(maxY, alive ? y2 + h[i] : -FLT_MAX);
+        minZ = std::min(minZ, alive ? z1 : FLT_MAX); maxZ = std::max(maxZ, alive ? z2 : -FLT_MAX);
+    }
+    
+    bounds[0] = minX; bounds[1] = minY; bounds[2] = minZ;
+    bounds[3] = maxX; bounds[4] = maxY; bounds[5] = maxZ;
+    return live > 0;
+}
+
+/**
+ * Grows a box, as for mergeBounds(), to include the live particles in the 
+ * range [begin, end) of the storage as they are rendered.
+ */
+static void boundParticles(GLfloat* bounds, bool& found, const ParticleStorage& storage, 
+                           const GLuint& begin, const GLuint& end, bool interpolate) {
+    if(begin >= end) {
+        return;
+    }
+    GLfloat box[6];
+    const bool live = interpolate ? boundParticles<true>(box, storage, begin, end)
+                                  : boundParticles<false>(box, storage, begin, end);
+    if(live) {
+        mergeBounds(bounds, found, box);
+    }
+}
+
+ParticleChunk::ParticleChunk(ParticleGenerator* const gen, const GLuint& b, const GLuint& e) :
+        generator(gen), 
+        begin(b), 
+        end(e),
+        bounded(false) {
+}
+
+ParticleChunk::~ParticleChunk() {
+}
+
+void ParticleChunk::execute() {
+    Random* previous = s_chunkRandom;
+    s_chunkRandom = &random;
+    generator->stepChunk(*this);
+    if(generator->m_trackBounds) {
+        generator->boundChunk(*this);
+    }
+    s_chunkRandom = previous;
+}
+
+//==============================================================================
+
+/**
+ * Vertex shader for instanced particles: every instance is a single particle,
+ * every vertex a corner of its quad, in the same order as renderImmediate().
+ */
+static const char* PARTICLE_VERTEX_SHADER =
+    "#version 120\n"
+    "attribute vec2 corner;\n"
+    "attribute vec3 position;\n"
+    "attribute vec2 size;\n"
+    "attribute vec4 color;\n"
+    "varying vec4 particleColor;\n"
+    "void main() {\n"
+    "    particleColor = color;\n"
+    "    vec3 vertex = position + vec3(corner * size, 0.0);\n"
+    "    gl_Position = gl_ModelViewProjectionMatrix * vec4(vertex, 1.0);\n"
+    "}\n";
+
+/// Fragment shader for instanced particles, plain unlit color.
+static const char* PARTICLE_FRAGMENT_SHADER =
+    "#version 120\n"
+    "varying vec4 particleColor;\n"
+    "void main() {\n"
+    "    gl_FragColor = particleColor;\n"
+    "}\n";
+
+/// Vertex attribute indices of the particle shader.
+enum ParticleAttribute {
+    ATTRIB_CORNER = 0,
+    ATTRIB_POSITION,
+    ATTRIB_SIZE,
+    ATTRIB_COLOR
+};
+
 ParticleGenerator::ParticleGenerator(const GLfloat& x, const GLfloat& y) :
         Object(x, y), 
         m_particles(NULL),
+        m_seed(sf::Randomizer::Random(0, 0x7fffffff)),
         m_max(100), 
-        m_particleLife(100.0f) {
+        m_particleLife(100.0f),
+        m_timestep(0.01),
+        m_accumulator(0.0),
+        m_maxSteps(10),
+        m_interpolate(false),
+        m_compact(false),
+        m_alive(0),
+        m_emissionRate(0.0f),
+        m_spawnBudget(0),
+        m_stepCount(0),
+        m_emissionCarry(0.0),
+        m_pending(0),
+        m_hasParticleBounds(false),
+        m_boundsDirty(true),
+        m_trackBounds(false),
+        m_renderMode(RENDER_BUFFER),
+        m_shader(PARTICLE_VERTEX_SHADER, PARTICLE_FRAGMENT_SHADER) {
             
+    m_shader.bindAttribute(ATTRIB_CORNER,   "corner");
+    m_shader.bindAttribute(ATTRIB_POSITION, "position");
+    m_shader.bindAttribute(ATTRIB_SIZE,     "size");
+    m_shader.bindAttribute(ATTRIB_COLOR,    "color");
+    
     // init default spreads:
     m_spread_x[0]       = -1.0f;
     m_spread_x[1]       =  1.0f;
@@ -372,31 +959,166 @@ ParticleGenerator::ParticleGenerator(const GLfloat& x, const GLfloat& y) :
     m_spread_fade[0]    = -1.5f;
     m_spread_fade[1]    = -0.1f;
     
+    // particles are colored quads, blended on top of the rest of the scene.
+    m_renderState.pass = PASS_TRANSPARENT;
+    m_renderState.lighting = false;
+    m_renderState.blending = true;
+    m_renderState.srcBlend = GL_SRC_ALPHA;
+    m_renderState.dstBlend = GL_ONE;
+    
     initialize();
 }
 
 ParticleGenerator::~ParticleGenerator() {
-    // Remove our particles (deallocate array)
+    // Remove our particle copies (deallocate array)
     delete[] m_particles;
 }
 
 void ParticleGenerator::initialize() {
-    // start initializing all the particles in the array, only if NULL.
-    if(m_particles == NULL) {
-        m_particles = new Particle[m_max];
+    // the particle copies are reallocated by getParticles() when needed.
+    delete[] m_particles;
+    m_particles = NULL;
+    
+    m_storage.resize(m_max);
+    
+    // split up the storage in chunks, each with their own random sequence
+    // derived from the seed.
+    m_random.setSeed(m_seed);
+    m_chunks.clear();
+    for(GLuint begin = 0; begin < m_max; begin += CHUNK_SIZE) {
+        m_chunks.push_back(ParticleChunk(this, begin, std::min(begin + CHUNK_SIZE, m_max)));
+        m_chunks.back().random.setSeed(m_seed ^ (m_chunks.size() * 0x9e3779b9U));
+    }
+    
+    // a compact generator starts out empty, and waits for emit().
+    m_alive = m_compact ? 0 : m_max;
+    m_stepCount = 0;
+    m_emissionCarry = 0.0;
+    m_pending = 0;
+    respawnParticles(0, m_alive, m_scratch);
+    m_boundsDirty = true;
+}
+
+GLuint ParticleGenerator::emit(const GLuint& count) {
+    if(!m_compact) {
+        return 0;
     }
-    for(GLuint i = 0; i < m_max; i++) {
-        initParticle(m_particles[i]);
+    
+    GLuint emitted = std::min(count, m_max - m_alive);
+    respawnParticles(m_alive, m_alive + emitted, m_scratch);
+    m_alive += emitted;
+    if(!m_boundsDirty) {
+        boundParticles(m_particleBounds, m_hasParticleBounds, m_storage, m_alive - emitted, m_alive, m_interpolate);
+    }
+    return emitted;
+}
+
+void ParticleGenerator::respawnParticle(const GLuint& i, Particle& scratch) {
+    // load the current state first, so initParticle() overrides which only
+    // set a few properties behave the same as with a plain particle array.
+    m_storage.load(i, scratch);
+    initParticle(scratch);
+    m_storage.store(i, scratch);
+}
+
+bool ParticleGenerator::probeInitParticle(Particle& scratch) {
+    // fill the particle with values initParticle() would never set, and see 
+    // whether they are left alone. The default implementation returns right
+    // away while probing.
+    const GLfloat unset = -FLT_MAX;
+    scratch.setPosition(unset, unset, unset);
+    scratch.setWidth(unset);
+    scratch.setHeight(unset);
+    scratch.setXv(unset);
+    scratch.setYv(unset);
+    scratch.setZv(unset);
+    scratch.setLife(unset);
+    scratch.setGravity(unset);
+    scratch.setFadeSpeed(unset);
+    scratch.setColor(Color(unset, unset, unset, unset));
+    scratch.setActive(false);
+    scratch.setCollisionEligible(false);
+    
+    unsigned char before[sizeof(Particle)];
+    std::memcpy(before, &scratch, sizeof(Particle));
+    s_probing = true;
+    s_probed = false;
+    initParticle(scratch);
+    s_probing = false;
+    return s_probed && std::memcmp(before, &scratch, sizeof(Particle)) == 0;
+}
+
+void ParticleGenerator::respawnParticles(const GLuint& begin, const GLuint& end, Particle& scratch) {
+    if(begin >= end) {
+        return;
+    }
+    if(!probeInitParticle(scratch)) {
+        for(GLuint i = begin; i < end; i++) {
+            respawnParticle(i, scratch);
+        }
+        return;
     }
+    
+    // the range is contiguous, so the random numbers go straight into the 
+    // velocity, gravity and fade arrays.
+    const GLuint count = end - begin;
+    GLfloat* xv = &m_storage.xv[begin];
+    GLfloat* yv = &m_storage.yv[begin];
+    GLfloat* zv = &m_storage.zv[begin];
+    GLfloat* gv = &m_storage.gravity[begin];
+    GLfloat* fs = &m_storage.fade[begin];
+    Random& random = getRandom();
+    random.fill(xv, count, m_spread_x[0],       m_spread_x[1]);
+    random.fill(yv, count, m_spread_y[0],       m_spread_y[1]);
+    random.fill(zv, count, m_spread_z[0],       m_spread_z[1]);
+    random.fill(gv, count, m_spread_gravity[0], m_spread_gravity[1]);
+    random.fill(fs, count, m_spread_fade[0],    m_spread_fade[1]);
+    spawnParticles(m_storage, RangeIndex(begin), count, xv, yv, zv, gv, fs, m_x, m_y, m_particleLife);
+}
+
+void ParticleGenerator::respawnParticles(const std::vector<GLuint>& indices, Particle& scratch, std::vector<GLfloat>& buffer) {
+    if(indices.empty()) {
+        return;
+    }
+    if(!probeInitParticle(scratch)) {
+        for(size_t k = 0; k < indices.size(); k++) {
+            respawnParticle(indices[k], scratch);
+        }
+        return;
+    }
+    
+    const GLuint count = indices.size();
+    buffer.resize(5 * count);
+    GLfloat* u = &buffer[0];
+    Random& random = getRandom();
+    random.fill(u,             count, m_spread_x[0],       m_spread_x[1]);
+    random.fill(u + count,     count, m_spread_y[0],       m_spread_y[1]);
+    random.fill(u + 2 * count, count, m_spread_z[0],       m_spread_z[1]);
+    random.fill(u + 3 * count, count, m_spread_gravity[0], m_spread_gravity[1]);
+    random.fill(u + 4 * count, count, m_spread_fade[0],    m_spread_fade[1]);
+    spawnParticles(m_storage, &indices[0], count, u, u + count, u + 2 * count, u + 3 * count, u + 4 * count, 
+                   m_x, m_y, m_particleLife);
+}
+
+Random& ParticleGenerator::getRandom() {
+    return s_chunkRandom != NULL ? *s_chunkRandom : m_random;
 }
 
 void ParticleGenerator::initParticle(Particle& p) {
-    // initialize some random numbers here.
-    float dx = sf::Randomizer::Random(m_spread_x[0],        m_spread_x[1]);
-    float dy = sf::Randomizer::Random(m_spread_y[0],        m_spread_y[1]);
-    float dz = sf::Randomizer::Random(m_spread_z[0],        m_spread_z[1]);
-    float gv = sf::Randomizer::Random(m_spread_gravity[0],  m_spread_gravity[1]);
-    float fs = sf::Randomizer::Random(m_spread_fade[0],     m_spread_fade[1]);
+    if(s_probing) {
+        s_probing = false;
+        s_probed = true;
+        return;
+    }
+    
+    // initialize some random numbers here, in one go.
+    GLfloat u[5];
+    getRandom().fill(u, 5, 0.0f, 1.0f);
+    float dx = m_spread_x[0]       + (m_spread_x[1]       - m_spread_x[0])       * u[0];
+    float dy = m_spread_y[0]       + (m_spread_y[1]       - m_spread_y[0])       * u[1];
+    float dz = m_spread_z[0]       + (m_spread_z[1]       - m_spread_z[0])       * u[2];
+    float gv = m_spread_gravity[0] + (m_spread_gravity[1] - m_spread_gravity[0]) * u[3];
+    float fs = m_spread_fade[0]    + (m_spread_fade[1]    - m_spread_fade[0])    * u[4];
     
     Color c(1.0f);
     
@@ -453,54 +1175,625 @@ void ParticleGenerator::setParticleLife(const GLfloat& particleLife) {
     m_particleLife = particleLife;
 }
 
+void ParticleGenerator::setTimestep(const double& timestep) {
+    m_timestep = timestep;
+}
+
+void ParticleGenerator::setMaxSteps(const GLuint& maxSteps) {
+    m_maxSteps = maxSteps;
+}
+
+void ParticleGenerator::setInterpolation(bool interpolate) {
+    m_interpolate = interpolate;
+    m_boundsDirty = true;
+}
+
+void ParticleGenerator::setSeed(const GLuint& seed) {
+    m_seed = seed;
+}
+
+void ParticleGenerator::setCompact(bool compact) {
+    m_compact = compact;
+}
+
+void ParticleGenerator::setEmissionRate(const GLfloat& rate) {
+    m_emissionRate = rate;
+}
+
+void ParticleGenerator::addBurst(const ParticleBurst& burst) {
+    m_bursts.push_back(burst);
+}
+
+void ParticleGenerator::clearBursts() {
+    m_bursts.clear();
+}
+
+void ParticleGenerator::setSpawnBudget(const GLuint& budget) {
+    m_spawnBudget = budget;
+}
+
+void ParticleGenerator::setRenderMode(const RenderMode& mode) {
+    m_renderMode = mode;
+}
+
 const GLfloat& ParticleGenerator::getParticleLife() const {
     return m_particleLife;
 }
 
+const double& ParticleGenerator::getTimestep() const {
+    return m_timestep;
+}
+
+const GLuint& ParticleGenerator::getMaxSteps() const {
+    return m_maxSteps;
+}
+
+bool ParticleGenerator::isInterpolation() const {
+    return m_interpolate;
+}
+
+const GLuint& ParticleGenerator::getSeed() const {
+    return m_seed;
+}
+
+bool ParticleGenerator::isCompact() const {
+    return m_compact;
+}
+
+const GLuint& ParticleGenerator::getAliveCount() const {
+    return m_alive;
+}
+
+const GLfloat& ParticleGenerator::getEmissionRate() const {
+    return m_emissionRate;
+}
+
+const std::vector<ParticleBurst>& ParticleGenerator::getBursts() const {
+    return m_bursts;
+}
+
+const GLuint& ParticleGenerator::getSpawnBudget() const {
+    return m_spawnBudget;
+}
+
+RenderMode ParticleGenerator::getRenderMode() const {
+    return m_renderMode;
+}
+
 const GLuint& ParticleGenerator::getMaxParticles() const {
     return m_max;
 }
 
-Particle* const ParticleGenerator::getParticles() const {
+Particle* const ParticleGenerator::getParticles() {
+    const GLuint& size = m_storage.getSize();
+    if(m_particles == NULL) {
+        m_particles = new Particle[size];
+    }
+    for(GLuint i = 0; i < size; i++) {
+        m_storage.load(i, m_particles[i]);
+    }
     return m_particles;
 }
 
+void ParticleGenerator::storeParticles() {
+    if(m_particles == NULL) {
+        return;
+    }
+    const GLuint& size = m_storage.getSize();
+    for(GLuint i = 0; i < size; i++) {
+        m_storage.store(i, m_particles[i]);
+    }
+    m_boundsDirty = true;
+}
+
+ParticleStorage& ParticleGenerator::getStorage() {
+    return m_storage;
+}
+
+void ParticleGenerator::extendBoundary(const GLuint& i) {
+    if(!m_boundsDirty) {
+        boundParticles(m_particleBounds, m_hasParticleBounds, m_storage, i, i + 1, m_interpolate);
+    }
+}
+
+GLuint ParticleGenerator::update(const double& dt) {
+    GLuint steps = advance(dt);
+    for(GLuint i = 0; i < steps; i++) {
+        step();
+    }
+    return steps;
+}
+
+GLuint ParticleGenerator::update(const double& dt, JobPool& pool) {
+    GLuint steps = advance(dt);
+    for(GLuint i = 0; i < steps; i++) {
+        addStepJobs(pool);
+        pool.run();
+        finishStep();
+    }
+    return steps;
+}
+
+GLuint ParticleGenerator::advance(const double& dt) {
+    m_accumulator += dt;
+    
+    GLuint steps = 0;
+    while(m_accumulator >= m_timestep && steps < m_maxSteps) {
+        m_accumulator -= m_timestep;
+        steps++;
+    }
+    
+    // we're lagging behind too much; drop the time we couldn't simulate.
+    if(m_accumulator >= m_timestep) {
+        m_accumulator = 0.0;
+    }
+    
+    return steps;
+}
+
+void ParticleGenerator::step() {
+    std::vector<ParticleChunk>::iterator it;
+    for(it = m_chunks.begin(); it < m_chunks.end() && it->begin < m_alive; it++) {
+        it->execute();
+    }
+    finishStep();
+}
+
+void ParticleGenerator::addStepJobs(JobPool& pool) {
+    // chunks past the live particles have nothing to do.
+    std::vector<ParticleChunk>::iterator it;
+    for(it = m_chunks.begin(); it < m_chunks.end() && it->begin < m_alive; it++) {
+        pool.add(&(*it));
+    }
+}
+
+void ParticleGenerator::finishStep() {
+    // the chunks which were stepped hold all live particles, so their boxes
+    // make up the complete box. Moving particles around below keeps it.
+    if(m_trackBounds) {
+        m_hasParticleBounds = false;
+        std::vector<ParticleChunk>::iterator chunk;
+        for(chunk = m_chunks.begin(); chunk < m_chunks.end(); chunk++) {
+            if(chunk->bounded) {
+                mergeBounds(m_particleBounds, m_hasParticleBounds, chunk->bounds);
+                chunk->bounded = false;
+            }
+        }
+        m_boundsDirty = false;
+    } else {
+        m_boundsDirty = true;
+    }
+    
+    if(!m_compact) {
+        return;
+    }
+    
+    // remove the dead particles from back to front, by moving the last live
+    // particle in their place. Going backwards, the last particle is never 
+    // one which still has to be removed.
+    std::vector<ParticleChunk>::reverse_iterator it;
+    for(it = m_chunks.rbegin(); it < m_chunks.rend(); it++) {
+        if(it->begin >= m_alive) {
+            it->dead.clear();
+            continue;
+        }
+        std::vector<GLuint>::reverse_iterator dead;
+        for(dead = it->dead.rbegin(); dead < it->dead.rend(); dead++) {
+            m_alive--;
+            if(*dead != m_alive) {
+                m_storage.copy(m_alive, *dead);
+            }
+        }
+        it->dead.clear();
+    }
+    
+    // schedule the particles for this step: the continuous rate, including
+    // what's left over from previous steps, and the bursts within this step.
+    m_emissionCarry += m_emissionRate * m_timestep;
+    GLuint scheduled = static_cast<GLuint>(m_emissionCarry);
+    m_emissionCarry -= scheduled;
+    
+    // the time is derived from the amount of steps, so it doesn't drift.
+    const double from = m_stepCount * m_timestep;
+    const double to   = (m_stepCount + 1) * m_timestep;
+    m_stepCount++;
+    
+    std::vector<ParticleBurst>::const_iterator burst;
+    for(burst = m_bursts.begin(); burst < m_bursts.end(); burst++) {
+        scheduled += burst->occurrences(from, to) * burst->count;
+    }
+    
+    // no point in holding back more than fits in the generator.
+    m_pending = std::min(m_pending + scheduled, m_max);
+    
+    GLuint spawn = m_pending;
+    if(m_spawnBudget > 0) {
+        spawn = std::min(spawn, m_spawnBudget);
+    }
+    // particles which don't fit are dropped.
+    emit(spawn);
+    m_pending -= spawn;
+}
+
+void ParticleGenerator::stepChunk(ParticleChunk& chunk) {
+    const GLuint& begin = chunk.begin;
+    const GLuint  end   = std::min(chunk.end, m_alive);
+    
+    // grab the arrays once, so the loops below do not go through the vectors.
+    const GLfloat* life = &m_storage.life[0];
+    GLclampf* r = &m_storage.r[0];
+    GLclampf* g = &m_storage.g[0];
+    GLclampf* b = &m_storage.b[0];
+    GLclampf* a = &m_storage.a[0];
+    const GLubyte* active = &m_storage.active[0];
+    
+    // remember where we were, for interpolation while rendering.
+    std::copy(m_storage.x.begin() + begin, m_storage.x.begin() + end, m_storage.px.begin() + begin);
+    std::copy(m_storage.y.begin() + begin, m_storage.y.begin() + end, m_storage.py.begin() + begin);
+    std::copy(m_storage.z.begin() + begin, m_storage.z.begin() + end, m_storage.pz.begin() + begin);
+    
+    // particles which are dead before this step get respawned, the others are
+    // moved. Particles dying during this step are respawned in the next one.
+    chunk.dead.clear();
+    for(GLuint i = begin; i < end; i++) {
+        if(!(life[i] > 0.0f && active[i])) {
+            chunk.dead.push_back(i);
+        }
+    }
+    
+    integrateParticles(m_storage, begin, end);
+    
+    std::vector<GLuint>::const_iterator dead = chunk.dead.begin();
+    for(GLuint i = begin; i < end; i++) {
+        if(dead != chunk.dead.end() && *dead == i) {
+            dead++;
+            continue;
+        }
+        // determine color:
+        GLfloat percentage = (life[i] / m_particleLife) * 100.0f;
+        Color c;
+        if(percentage >= 70.0f) {
+            c = Color::RED;
+        } else if (percentage >= 50.0f && percentage < 70.0f) {
+            c = Color::ORANGE;
+        } else if (percentage >= 0.0f && percentage < 50.0f) {
+            c = Color::YELLOW;
+        }
+        r[i] = c.getR();
+        g[i] = c.getG();
+        b[i] = c.getB();
+        // set alpha value based on percentage of life. Lesser life, 
+        // lesser alpha, it will dissapear eventually.
+        a[i] = life[i] / m_particleLife;
+    }
+    
+    if(m_compact) {
+        // leave the particles which are dead now to finishStep().
+        chunk.dead.clear();
+        for(GLuint i = begin; i < end; i++) {
+            if(!(life[i] > 0.0f && active[i])) {
+                chunk.dead.push_back(i);
+            }
+        }
+        return;
+    }
+    
+    respawnParticles(chunk.dead, chunk.scratch, chunk.spawn);
+}
+
+void ParticleGenerator::boundChunk(ParticleChunk& chunk) {
+    chunk.bounded = false;
+    boundParticles(chunk.bounds, chunk.bounded, m_storage, chunk.begin, std::min(chunk.end, m_alive), m_interpolate);
+}
+
+void ParticleGenerator::updateBoundary() {
+    m_hasParticleBounds = false;
+    m_boundsDirty = false;
+    boundParticles(m_particleBounds, m_hasParticleBounds, m_storage, 0, m_alive, m_interpolate);
+}
+
+const AABB3& ParticleGenerator::getBoundary3D() {
+    m_trackBounds = true;
+    if(m_boundsDirty) {
+        updateBoundary();
+    }
+    // without particles, the box is at the generator, wherever it is now.
+    if(m_hasParticleBounds) {
+        const GLfloat* b = m_particleBounds;
+        m_boundaryBox3D = AABB3(b[0], b[1], b[2], b[3] - b[0], b[4] - b[1], b[5] - b[2]);
+    } else {
+        m_boundaryBox3D = AABB3(m_x, m_y, m_z, 0.0f, 0.0f, 0.0f);
+    }
+    return m_boundaryBox3D;
+}
+
+const Rect& ParticleGenerator::getBoundary() {
+    const AABB3& box = getBoundary3D();
+    m_boundaryBox.x = box.x;
+    m_boundaryBox.y = box.y;
+    m_boundaryBox.w = box.w;
+    m_boundaryBox.h = box.h;
+    return m_boundaryBox;
+}
+
 void ParticleGenerator::render() {   
+    if(m_alive == 0) {
+        return;
+    }
+    
+    switch(m_renderMode) {
+        case RENDER_BUFFER:
+            renderBuffer();
+            break;
+        case RENDER_INSTANCED:
+            renderInstanced();
+            break;
+        default:
+            renderImmediate();
+            break;
+    }
+}
+
+/**
+ * Gets the position of a particle to render: between its position before and
+ * after the last step when interpolating, or exactly its current position 
+ * when not. Blending with an alpha of one would not give exactly the current
+ * position, due to rounding.
+ */
+static inline GLfloat renderPosition(const GLfloat& previous, const GLfloat& current, const GLfloat& alpha, bool interpolate) {
+    return interpolate ? previous + (current - previous) * alpha : current;
+}
+
+void ParticleGenerator::renderImmediate() {
+    const GLuint& size = m_alive;
+    
+    const GLfloat* x  = &m_storage.x[0];
+    const GLfloat* y  = &m_storage.y[0];
+    const GLfloat* z  = &m_storage.z[0];
+    const GLfloat* px = &m_storage.px[0];
+    const GLfloat* py = &m_storage.py[0];
+    const GLfloat* pz = &m_storage.pz[0];
+    const GLfloat* life = &m_storage.life[0];
+    const GLclampf* r = &m_storage.r[0];
+    const GLclampf* g = &m_storage.g[0];
+    const GLclampf* b = &m_storage.b[0];
+    const GLclampf* a = &m_storage.a[0];
+    const GLfloat* w = &m_storage.width[0];
+    const GLfloat* h = &m_storage.height[0];
+    const GLubyte* active = &m_storage.active[0];
+    
+    // fraction of the next step which has passed already. When not 
+    // interpolating, the last simulated step is rendered as is.
+    const GLfloat alpha = m_interpolate ? static_cast<GLfloat>(m_accumulator / m_timestep) : 1.0f;
+    
     glBegin(GL_QUADS);
-        for(GLuint i = 0; i < m_max; i++) {   
-            Particle& p = m_particles[i];
-            if(p.getLife() > 0.0f && p.isActive()) {
-                p.setX(p.getX() + p.getXv());
-                p.setY(p.getY() + p.getYv());
-                p.setZ(p.getZ() + p.getZv());
-                
-                p.setYv(p.getYv() + p.getGravity());
-                
-                p.setLife(p.getLife() + p.getFadeSpeed());
-                
-                // determine color:
-                GLfloat percentage = (p.getLife() / m_particleLife) * 100.0f;
-                Color c;
-                if(percentage >= 70.0f) {
-                    c = Color::RED;
-                } else if (percentage >= 50.0f && percentage < 70.0f) {
-                    c = Color::ORANGE;
-                } else if (percentage >= 0.0f && percentage < 50.0f) {
-                    c = Color::YELLOW;
-                }
-                // set alpha value based on percentage of life. Lesser life, 
-                // lesser alpha, it will dissapear eventually.
-                c.setA(p.getLife() / m_particleLife);
-                p.setColor(c);
-                
-                // last but not least, render the individual particle.
-                p.render();
-            } else {
-                initParticle(p);
+        for(GLuint i = 0; i < size; i++) {   
+            // same check as Particle::render().
+            if(life[i] > 0.0f && active[i]) {
+                const GLfloat rx = renderPosition(px[i], x[i], alpha, m_interpolate);
+                const GLfloat ry = renderPosition(py[i], y[i], alpha, m_interpolate);
+                const GLfloat rz = renderPosition(pz[i], z[i], alpha, m_interpolate);
+                glColor4f(r[i], g[i], b[i], a[i]);
+                glVertex3f(rx, ry, rz);
+                glVertex3f(rx, ry + h[i], rz);
+                glVertex3f(rx + w[i], ry + h[i], rz);
+                glVertex3f(rx + w[i], ry, rz);
             }
         }
     glEnd();
 }
 
+/// Vertex layout used by ParticleGenerator::renderBuffer().
+struct ParticleVertex {
+    GLfloat x, y, z;
+    GLubyte r, g, b, a;
+};
+
+/**
+ * Converts a color component to a byte, the same way OpenGL does.
+ */
+static inline GLubyte toByte(const GLclampf& c) {
+    return static_cast<GLubyte>(std::min(std::max(c, 0.0f), 1.0f) * 255.0f + 0.5f);
+}
+
+void ParticleGenerator::renderBuffer() {
+    const GLuint& size = m_alive;
+    
+    const GLfloat* x  = &m_storage.x[0];
+    const GLfloat* y  = &m_storage.y[0];
+    const GLfloat* z  = &m_storage.z[0];
+    const GLfloat* px = &m_storage.px[0];
+    const GLfloat* py = &m_storage.py[0];
+    const GLfloat* pz = &m_storage.pz[0];
+    const GLfloat* life = &m_storage.life[0];
+    const GLclampf* r = &m_storage.r[0];
+    const GLclampf* g = &m_storage.g[0];
+    const GLclampf* b = &m_storage.b[0];
+    const GLclampf* a = &m_storage.a[0];
+    const GLfloat* w = &m_storage.width[0];
+    const GLfloat* h = &m_storage.height[0];
+    const GLubyte* active = &m_storage.active[0];
+    
+    const GLfloat alpha = m_interpolate ? static_cast<GLfloat>(m_accumulator / m_timestep) : 1.0f;
+    
+    ParticleVertex* v = static_cast<ParticleVertex*>(m_vertices.map(size * 4 * sizeof(ParticleVertex)));
+    if(v == NULL) {
+        return;
+    }
+    
+    // same quads as renderImmediate(), four vertices per particle.
+    GLsizei count = 0;
+    for(GLuint i = 0; i < size; i++) {
+        if(life[i] > 0.0f && active[i]) {
+            const GLfloat rx = renderPosition(px[i], x[i], alpha, m_interpolate);
+            const GLfloat ry = renderPosition(py[i], y[i], alpha, m_interpolate);
+            const GLfloat rz = renderPosition(pz[i], z[i], alpha, m_interpolate);
+            ParticleVertex c;
+            c.r = toByte(r[i]);
+            c.g = toByte(g[i]);
+            c.b = toByte(b[i]);
+            c.a = toByte(a[i]);
+            c.z = rz;
+            v[0] = c; v[0].x = rx;        v[0].y = ry;
+            v[1] = c; v[1].x = rx;        v[1].y = ry + h[i];
+            v[2] = c; v[2].x = rx + w[i]; v[2].y = ry + h[i];
+            v[3] = c; v[3].x = rx + w[i]; v[3].y = ry;
+            v += 4;
+            count += 4;
+        }
+    }
+    if(!m_vertices.unmap()) {
+        m_vertices.unbind();
+        return;
+    }
+    
+    const GLubyte* base = m_vertices.getPointer();
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glVertexPointer(3, GL_FLOAT, sizeof(ParticleVertex), base + offsetof(ParticleVertex, x));
+    glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(ParticleVertex), base + offsetof(ParticleVertex, r));
+    glDrawArrays(GL_QUADS, 0, count);
+    glPopClientAttrib();
+    m_vertices.unbind();
+}
+
+/// Per instance layout used by ParticleGenerator::renderInstanced().
+struct ParticleInstance {
+    GLfloat x, y, z;
+    GLfloat w, h;
+    GLubyte r, g, b, a;
+};
+
+/// Corners of a unit quad, as a triangle fan in the order of renderImmediate().
+static const GLfloat PARTICLE_CORNERS[4][2] = {
+    { 0.0f, 0.0f },
+    { 0.0f, 1.0f },
+    { 1.0f, 1.0f },
+    { 1.0f, 0.0f }
+};
+
+void ParticleGenerator::renderInstanced() {
+    GLExtensions::load();
+    if(!GLExtensions::hasInstancing() || !m_shader.use()) {
+        renderBuffer();
+        return;
+    }
+    
+    const GLuint& size = m_alive;
+    
+    const GLfloat* x  = &m_storage.x[0];
+    const GLfloat* y  = &m_storage.y[0];
+    const GLfloat* z  = &m_storage.z[0];
+    const GLfloat* px = &m_storage.px[0];
+    const GLfloat* py = &m_storage.py[0];
+    const GLfloat* pz = &m_storage.pz[0];
+    const GLfloat* life = &m_storage.life[0];
+    const GLclampf* r = &m_storage.r[0];
+    const GLclampf* g = &m_storage.g[0];
+    const GLclampf* b = &m_storage.b[0];
+    const GLclampf* a = &m_storage.a[0];
+    const GLfloat* w = &m_storage.width[0];
+    const GLfloat* h = &m_storage.height[0];
+    const GLubyte* active = &m_storage.active[0];
+    
+    const GLfloat alpha = m_interpolate ? static_cast<GLfloat>(m_accumulator / m_timestep) : 1.0f;
+    
+    // the unit quad goes in front of the instances, so one buffer will do.
+    const GLsizeiptr corners = sizeof(PARTICLE_CORNERS);
+    GLubyte* data = static_cast<GLubyte*>(m_vertices.map(corners + size * sizeof(ParticleInstance)));
+    if(data == NULL) {
+        ShaderProgram::release();
+        return;
+    }
+    memcpy(data, PARTICLE_CORNERS, corners);
+    
+    ParticleInstance* p = reinterpret_cast<ParticleInstance*>(data + corners);
+    GLsizei count = 0;
+    for(GLuint i = 0; i < size; i++) {
+        if(life[i] > 0.0f && active[i]) {
+            p->x = renderPosition(px[i], x[i], alpha, m_interpolate);
+            p->y = renderPosition(py[i], y[i], alpha, m_interpolate);
+            p->z = renderPosition(pz[i], z[i], alpha, m_interpolate);
+            p->w = w[i];
+            p->h = h[i];
+            p->r = toByte(r[i]);
+            p->g = toByte(g[i]);
+            p->b = toByte(b[i]);
+            p->a = toByte(a[i]);
+            p++;
+            count++;
+        }
+    }
+    if(!m_vertices.unmap()) {
+        m_vertices.unbind();
+        ShaderProgram::release();
+        return;
+    }
+    
+    const GLubyte* base = m_vertices.getPointer();
+    const GLubyte* instances = base + corners;
+    const GLsizei stride = sizeof(ParticleInstance);
+    
+    GLExtensions::vertexAttribPointer(ATTRIB_CORNER, 2, GL_FLOAT, GL_FALSE, 0, base);
+    GLExtensions::vertexAttribPointer(ATTRIB_POSITION, 3, GL_FLOAT, GL_FALSE, stride, instances + offsetof(ParticleInstance, x));
+    GLExtensions::vertexAttribPointer(ATTRIB_SIZE, 2, GL_FLOAT, GL_FALSE, stride, instances + offsetof(ParticleInstance, w));
+    GLExtensions::vertexAttribPointer(ATTRIB_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, instances + offsetof(ParticleInstance, r));
+    for(GLuint i = ATTRIB_CORNER; i <= ATTRIB_COLOR; i++) {
+        GLExtensions::enableVertexAttribArray(i);
+        GLExtensions::vertexAttribDivisor(i, i == ATTRIB_CORNER ? 0 : 1);
+    }
+    
+    GLExtensions::drawArraysInstanced(GL_TRIANGLE_FAN, 0, 4, count);
+    
+    // leave the attribute state as we found it.
+    for(GLuint i = ATTRIB_CORNER; i <= ATTRIB_COLOR; i++) {
+        GLExtensions::vertexAttribDivisor(i, 0);
+        GLExtensions::disableVertexAttribArray(i);
+    }
+    m_vertices.unbind();
+    ShaderProgram::release();
+}
+
+//==============================================================================
+
+ParticleUpdater::ParticleUpdater(JobPool& pool) :
+        m_pool(pool) {
+}
+
+ParticleUpdater::~ParticleUpdater() {
+}
+
+void ParticleUpdater::addGenerator(ParticleGenerator* const generator) {
+    m_generators.push_back(generator);
+}
+
+GLuint ParticleUpdater::update(const double& dt) {
+    GLuint maxSteps = 0;
+    m_steps.resize(m_generators.size());
+    for(size_t i = 0; i < m_generators.size(); i++) {
+        m_steps[i] = m_generators[i]->advance(dt);
+        maxSteps = std::max(maxSteps, m_steps[i]);
+    }
+    
+    // every run of the pool simulates one step of all generators which still
+    // have steps left.
+    for(GLuint step = 0; step < maxSteps; step++) {
+        for(size_t i = 0; i < m_generators.size(); i++) {
+            if(step < m_steps[i]) {
+                m_generators[i]->addStepJobs(m_pool);
+            }
+        }
+        m_pool.run();
+        
+        for(size_t i = 0; i < m_generators.size(); i++) {
+            if(step < m_steps[i]) {
+                m_generators[i]->finishStep();
+            }
+        }
+    }
+    
+    return maxSteps;
+}
 
 } // namespace ogle
@@ -20,6 +20,11 @@
 #ifndef CORE_HPP
 #define CORE_HPP
 
+#include "buffer.hpp"
+#include "jobs.hpp"
+#include "random.hpp"
+#include "shader.hpp"
+
 #include <SFML/Window.hpp>
 
 #include <iostream>
@@ -181,6 +186,142 @@ public:
 
 //==============================================================================
 
+/**
+ * Axis aligned box in three-dimensional space. It's built up like a Rect, with
+ * a depth along the z-axis: (x, y, z) - (w, h, d).
+ */
+class AABB3 {
+public:
+
+    /**
+     * Creates this box.
+     */
+    AABB3(const GLfloat& x = 0.0f, const GLfloat& y = 0.0f, const GLfloat& z = 0.0f,
+          const GLfloat& w = 0.0f, const GLfloat& h = 0.0f, const GLfloat& d = 0.0f);
+    
+    /**
+     * Creates this box from a rectangle, placed at the given depth.
+     * 
+     * @param rect The rectangle, giving (x, y) - (w, h).
+     * @param z The z coordinate.
+     * @param d The depth.
+     */
+    AABB3(const Rect& rect, const GLfloat& z = 0.0f, const GLfloat& d = 0.0f);
+    
+    ~AABB3();
+    
+    /// First x coordinate.
+    GLfloat x;
+    
+    /// First y coordinate.
+    GLfloat y;
+    
+    /// First z coordinate.
+    GLfloat z;
+    
+    /// Width of the box.
+    GLfloat w;
+    
+    /// Height of the box.
+    GLfloat h;
+    
+    /// Depth of the box.
+    GLfloat d;
+    
+    /**
+     * Checks if this box is intersecting another box. Like with 
+     * Rect::intersects(), boxes which only touch intersect too, so boxes 
+     * without depth intersect when they are at the same depth.
+     * 
+     * @param other The other box to test with.
+     * @return true if they intersect.
+     */
+    bool intersects(const AABB3& other) const;
+    
+    /**
+     * Gets this box projected on the xy plane.
+     * 
+     * @return The rectangle (x, y) - (w, h).
+     */
+    Rect getRect() const;
+};
+
+//==============================================================================
+
+/**
+ * The passes objects are rendered in. Opaque objects are rendered first, and
+ * transparent objects last, from back to front.
+ */
+enum RenderPass {
+    /// Objects which write depth and need no particular order.
+    PASS_OPAQUE = 0,
+    
+    /// Blended objects, rendered after the opaque ones.
+    PASS_TRANSPARENT = 1
+};
+
+/**
+ * The OpenGL state an object is rendered with. A RenderQueue uses this to 
+ * sort objects, so only the state which differs between two objects is 
+ * changed. The default is an opaque, lit object without blending and without
+ * a material of its own.
+ */
+class RenderState {
+public:
+    /**
+     * Creates the default state.
+     */
+    RenderState();
+    
+    ~RenderState();
+    
+    /// The pass to render in.
+    RenderPass pass;
+    
+    /// Whether GL_LIGHTING is enabled.
+    bool lighting;
+    
+    /// Whether GL_BLEND is enabled.
+    bool blending;
+    
+    /// Source factor of the blend function, when blending.
+    GLenum srcBlend;
+    
+    /// Destination factor of the blend function, when blending.
+    GLenum dstBlend;
+    
+    /// Whether the material is set. If not, the material is left as it is.
+    bool material;
+    
+    /// The ambient and diffuse color of the material, when set.
+    Color color;
+    
+    /// The winding of front faces.
+    GLenum frontFace;
+    
+    /**
+     * Checks whether two states set exactly the same OpenGL state.
+     * 
+     * @param other The other state.
+     * @return true when they are the same.
+     */
+    bool operator==(const RenderState& other) const;
+    
+    bool operator!=(const RenderState& other) const;
+    
+    /**
+     * Orders states, so they can be the keys of a std::map. Like operator==,
+     * this ignores the blend function and material when they are not used, so
+     * two states are equivalent exactly when they are equal.
+     * 
+     * @param other The other state.
+     * @return true when this state goes before the other.
+     */
+    bool operator<(const RenderState& other) const;
+};
+
+//==============================================================================
+
 /**
  * Base object for anything (2D) renderable in Ogle.
  */
@@ -207,6 +348,17 @@ protected:
     /// The object's boundary box.
     Rect m_boundaryBox;
     
+    /// The object's boundary box in three dimensions.
+    AABB3 m_boundaryBox3D;
+    
+    /// Whether the position or size changed since the geometry of this object
+    /// was last built. Set by the setters, cleared by subclasses which cache
+    /// their geometry.
+    bool m_dirty;
+    
+    /// The state this object is rendered with by a RenderQueue.
+    RenderState m_renderState;
+    
 public:
     /**
      * Constructs a brand new Object, with the specified coordinates.
@@ -296,11 +448,44 @@ public:
      */
     virtual const Rect& getBoundary();
     
+    /**
+     * Gets the boundary of this object as a box in three dimensions, like 
+     * getBoundary() but with the z coordinate. An object is flat by default,
+     * so its box has no depth. Like with getBoundary(), the same object is 
+     * returned every call.
+     * 
+     * @return The boundary of this single object as an AABB3 object.
+     */
+    virtual const AABB3& getBoundary3D();
+    
+    /**
+     * Sets the state this object is rendered with by a RenderQueue.
+     * 
+     * @param state The state.
+     */
+    void setRenderState(const RenderState& state);
+    
+    /**
+     * Gets the state this object is rendered with by a RenderQueue.
+     * 
+     * @return The state.
+     */
+    const RenderState& getRenderState() const;
+    
     /**
      * Pure abstract method to render an object. This must be overridden by a
      * subclass.
      */
     virtual void render() = 0;
+    
+    /**
+     * Draws the object, with the state of getRenderState() already set. This
+     * is used by a RenderQueue, which sets the state only when it differs from
+     * the previous object. Subclasses which set state in render() should 
+     * override this to draw without setting any state. The default just calls
+     * render().
+     */
+    virtual void draw();
 };
 
 //==============================================================================
@@ -313,11 +498,54 @@ class Box : public Object {
 private:
     /// Box depth (over the z axis).
     GLfloat m_depth;
+    
+    /// The faces of the box, rebuilt only when the box changed.
+    VertexBuffer m_geometry;
+    
+    /**
+     * Writes the faces of the box into m_geometry, and marks the box clean.
+     * 
+     * @return false when writing failed; the box stays dirty.
+     */
+    bool buildGeometry();
+    
 public:
     Box();
+    
+    /**
+     * Copies a box. The copy builds its own geometry.
+     */
+    Box(const Box& other);
+    
     ~Box();
     
+    Box& operator=(const Box& other);
+    
+    /**
+     * Sets the depth of this box.
+     * 
+     * @param depth The depth, over the z axis.
+     */
+    void setDepth(const GLfloat& depth);
+    
+    const GLfloat& getDepth() const;
+    
+    /**
+     * Gets the boundary of this box, including its depth.
+     */
+    virtual const AABB3& getBoundary3D();
+    
+    /**
+     * Renders the box from its cached geometry, which is only rebuilt after 
+     * the position or size changed. Sets the material color of the render 
+     * state, red by default.
+     */
     virtual void render();
+    
+    /**
+     * Draws the cached geometry, without setting the material.
+     */
+    virtual void draw();
 };
 
 //==============================================================================
@@ -342,9 +570,20 @@ public:
     ~Axis();
     
     /**
-     * Renders this axis.
+     * Gets the boundary of this axis: a cube around the origin, reaching to
+     * the ends of the axis.
+     */
+    virtual const AABB3& getBoundary3D();
+    
+    /**
+     * Renders this axis, with lighting disabled.
      */
     void render();
+    
+    /**
+     * Draws the lines of this axis. The render state has lighting disabled.
+     */
+    void draw();
 };
 
 //==============================================================================
@@ -530,6 +769,222 @@ public:
 
 //==============================================================================
 
+/**
+ * Structure-of-arrays storage for particles. Instead of keeping an array of
+ * complete Particle objects, every property is kept in its own contiguous 
+ * array, indexed by the particle number. The integration step of a particle
+ * generator only touches positions, velocities, gravity and life, so this way
+ * it does not drag colors, boundary boxes and vtable pointers through the cache.
+ * 
+ * The arrays are public for the sake of fast iteration. load() and store() can
+ * be used to convert between a single Particle object and the arrays.
+ */
+class ParticleStorage {
+private:
+    /// Amount of particles in this storage.
+    GLuint m_size;
+
+public:
+    /**
+     * Creates an empty particle storage.
+     */
+    ParticleStorage();
+    
+    /**
+     * Destroys this storage.
+     */
+    ~ParticleStorage();
+    
+    /**
+     * Resizes all arrays to hold the given amount of particles. Existing
+     * particles are retained when growing, new particles get the defaults of
+     * a freshly constructed Particle.
+     * 
+     * @param size The new amount of particles.
+     */
+    void resize(const GLuint& size);
+    
+    /**
+     * Gets the amount of particles in this storage.
+     * 
+     * @return The amount of particles.
+     */
+    const GLuint& getSize() const;
+    
+    /**
+     * Copies all properties of the particle at index from to index to.
+     * 
+     * @param from The index of the particle to copy.
+     * @param to The index of the particle to overwrite.
+     */
+    void copy(const GLuint& from, const GLuint& to);
+    
+    /**
+     * Copies the properties of the particle at index i to the given particle.
+     * 
+     * @param i The index of the particle in this storage.
+     * @param p The particle to copy the properties to.
+     */
+    void load(const GLuint& i, Particle& p) const;
+    
+    /**
+     * Copies the properties of the given particle to index i of this storage.
+     * The previous position is set to the new position as well, so the 
+     * particle does not get interpolated from wherever it was before.
+     * 
+     * @param i The index of the particle in this storage.
+     * @param p The particle to copy the properties from.
+     */
+    void store(const GLuint& i, const Particle& p);
+    
+    /// Positions on the x, y and z axis.
+    std::vector<GLfloat> x, y, z;
+    
+    /// Positions on the x, y and z axis before the last simulation step.
+    std::vector<GLfloat> px, py, pz;
+    
+    /// Velocities on the x, y and z axis.
+    std::vector<GLfloat> xv, yv, zv;
+    
+    /// Lifetime of each particle.
+    std::vector<GLfloat> life;
+    
+    /// Gravity of each particle.
+    std::vector<GLfloat> gravity;
+    
+    /// Fade speed of each particle.
+    std::vector<GLfloat> fade;
+    
+    /// Color components of each particle.
+    std::vector<GLclampf> r, g, b, a;
+    
+    /// Width and height of each particle.
+    std::vector<GLfloat> width, height;
+    
+    /// Whether the particle is active (non-zero) or not (zero).
+    std::vector<GLubyte> active;
+    
+    /// Whether the particle is eligible for collision detection (non-zero) or not (zero).
+    std::vector<GLubyte> collisionEligible;
+};
+
+//==============================================================================
+
+/**
+ * A burst of particles emitted by a ParticleGenerator at a certain time after
+ * initialization, optionally repeated at an interval.
+ */
+class ParticleBurst {
+public:
+    /**
+     * Creates a burst.
+     * 
+     * @param time Simulated time after initialization of the first burst, in seconds.
+     * @param count The amount of particles to emit.
+     * @param interval Time between repeated bursts in seconds, or 0.0 to emit once.
+     */
+    ParticleBurst(const double& time = 0.0, const GLuint& count = 0, const double& interval = 0.0);
+    
+    ~ParticleBurst();
+    
+    /// Simulated time after initialization of the first burst, in seconds.
+    double time;
+    
+    /// The amount of particles to emit.
+    GLuint count;
+    
+    /// Time between repeated bursts in seconds, or 0.0 to emit once.
+    double interval;
+    
+    /**
+     * Counts how many times this burst happens in the time span [from, to).
+     * 
+     * @param from Start of the time span.
+     * @param to End of the time span.
+     * @return The amount of bursts.
+     */
+    GLuint occurrences(const double& from, const double& to) const;
+};
+
+//==============================================================================
+
+class ParticleGenerator;
+
+/**
+ * A range of particles of a ParticleGenerator which is simulated as a single
+ * job. Every chunk has its own random number generator and scratch space, so
+ * chunks can be simulated in parallel, and give the same results for the same
+ * seed no matter how many threads are used.
+ */
+class ParticleChunk : public Job {
+public:
+    /**
+     * Creates a chunk.
+     * 
+     * @param generator The generator the particles belong to.
+     * @param begin The index of the first particle.
+     * @param end One past the index of the last particle.
+     */
+    ParticleChunk(ParticleGenerator* const generator = NULL, const GLuint& begin = 0, const GLuint& end = 0);
+    
+    ~ParticleChunk();
+    
+    /// The generator the particles belong to.
+    ParticleGenerator* generator;
+    
+    /// The index of the first particle.
+    GLuint begin;
+    
+    /// One past the index of the last particle.
+    GLuint end;
+    
+    /// Random number generator used while respawning particles in this chunk.
+    Random random;
+    
+    /// Scratch particle, used to call initParticle() for a single storage index.
+    Particle scratch;
+    
+    /// Indices of the particles to respawn, or to remove when compact.
+    std::vector<GLuint> dead;
+    
+    /// Random numbers for respawning the dead particles, one attribute at a time.
+    std::vector<GLfloat> spawn;
+    
+    /// Box around the live particles of this chunk after its last step, as the
+    /// minimum x, y, z followed by the maximum x, y, z.
+    GLfloat bounds[6];
+    
+    /// Whether there were live particles to put bounds around.
+    bool bounded;
+    
+    /**
+     * Simulates one step of the particles in this chunk, and puts a box 
+     * around them when the generator keeps track of its box. While doing so,
+     * the generator's getRandom() returns the random number generator of this
+     * chunk.
+     */
+    virtual void execute();
+};
+
+//==============================================================================
+
+/**
+ * Ways for a ParticleGenerator to render its particles.
+ */
+enum RenderMode {
+    /// Immediate mode: a glColor and four glVertex calls per particle.
+    RENDER_IMMEDIATE,
+    
+    /// All particles written to a VertexBuffer, drawn with a single call.
+    RENDER_BUFFER,
+    
+    /// One record per particle, expanded to a quad by a vertex shader using
+    /// instanced drawing. Falls back to RENDER_BUFFER when not supported.
+    RENDER_INSTANCED
+};
+
+//==============================================================================
+
 /**
  * This is a default 'reference' implementation of a ParticleGenerator. It can
  * be used as a base class for other types of ParticleGenerators, with different
@@ -542,8 +997,23 @@ public:
 class ParticleGenerator : public Object {
 private:
 
-    /// Array with fluffy particles.
+    /// Storage with fluffy particles.
+    ParticleStorage m_storage;
+    
+    /// Array of Particle objects, only filled on request by getParticles().
     Particle* m_particles;
+    
+    /// Scratch particle, used to call initParticle() for a single storage index.
+    Particle m_scratch;
+    
+    /// The storage split up in chunks, which are simulated as separate jobs.
+    std::vector<ParticleChunk> m_chunks;
+    
+    /// Seed for the random number generators.
+    GLuint m_seed;
+    
+    /// Random number generator used outside of chunks, e.g. by initialize().
+    Random m_random;
 
     /// Maximum amount of particles.
     GLuint m_max;
@@ -565,9 +1035,72 @@ private:
     
     /// The spread of fadespeed, i.e. decreasement of lifetime per particle.
     GLfloat m_spread_fade[2];
+    
+    /// Duration of a single simulation step, in seconds.
+    double m_timestep;
+    
+    /// Time passed by update() which has not been simulated yet, in seconds.
+    double m_accumulator;
+    
+    /// Maximum amount of steps to simulate in a single update() call.
+    GLuint m_maxSteps;
+    
+    /// Whether to interpolate particle positions between the last two steps when rendering.
+    bool m_interpolate;
+    
+    /// Whether live particles are kept packed at the front of the storage.
+    bool m_compact;
+    
+    /// Amount of live particles at the front of the storage. Equal to m_max when not compact.
+    GLuint m_alive;
+    
+    /// Particles to emit per second of simulated time, when compact.
+    GLfloat m_emissionRate;
+    
+    /// Bursts of particles to emit, when compact.
+    std::vector<ParticleBurst> m_bursts;
+    
+    /// Maximum amount of particles to emit per step, or 0 for no limit.
+    GLuint m_spawnBudget;
+    
+    /// Amount of steps simulated since initialization.
+    unsigned long m_stepCount;
+    
+    /// Fraction of a particle left over from the emission rate.
+    double m_emissionCarry;
+    
+    /// Particles scheduled for emission, but held back by the spawn budget.
+    GLuint m_pending;
+    
+    /// Box around the live particles, as the minimum x, y, z followed by the maximum x, y, z.
+    GLfloat m_particleBounds[6];
+    
+    /// Whether there were live particles to put m_particleBounds around.
+    bool m_hasParticleBounds;
+    
+    /// Whether the particles changed so m_particleBounds must be computed from scratch.
+    bool m_boundsDirty;
+    
+    /// Whether the chunks put boxes around their particles while stepping. Only
+    /// done once getBoundary3D() was used, so nothing is spent on it otherwise.
+    bool m_trackBounds;
+    
+    /// How to render the particles.
+    RenderMode m_renderMode;
+    
+    /// Vertices of the particles, when rendering from a buffer.
+    VertexBuffer m_vertices;
+    
+    /// Shader which expands the particles to quads, when rendering instanced.
+    ShaderProgram m_shader;
+
+    friend class ParticleChunk;
 
 public:
 
+    /// Amount of particles per chunk. Fixed, so results do not depend on the amount of threads.
+    static const GLuint CHUNK_SIZE = 4096;
+
     /**
      * Constructor.
      * 
@@ -583,15 +1116,20 @@ public:
        
     /**
      * Initializes the particle generator and its particles. Always call this
-     * after you've set properties using the setter functions. This will iterate
-     * over the particle array, and call initParticle for each single particle
-     * instance.
+     * after you've set properties using the setter functions. This will 
+     * initialize every particle, as initParticle() does.
      */
     virtual void initialize();
     
     /**
      * Initializes a single particle to the defaults for this generator.
      * 
+     * Unless this function is overridden, particles are initialized in 
+     * batches, straight in the particle storage, and this function is not 
+     * called for them. An override is detected by calling it once for every
+     * batch, on a scratch particle: it counts as overridden when it changes
+     * that particle, or when it does not call this implementation.
+     * 
      * @param p The particle reference to initialize.
      */
     virtual void initParticle(Particle& p);
@@ -615,8 +1153,142 @@ public:
     
     void setParticleLife(const GLfloat& particleLife);
     
+    /**
+     * Sets the duration of a single simulation step. Velocities, gravity and
+     * fade speed are applied once per step, so this controls the speed of the
+     * simulation. Defaults to 0.01 seconds (100 steps per second).
+     * 
+     * @param timestep The duration of a step in seconds.
+     */
+    void setTimestep(const double& timestep);
+    
+    /**
+     * Sets the maximum amount of steps a single update() call may simulate.
+     * When an update lags behind more than this, the remaining time is 
+     * dropped instead of trying to catch up forever. Defaults to 10.
+     * 
+     * @param maxSteps The maximum amount of steps per update.
+     */
+    void setMaxSteps(const GLuint& maxSteps);
+    
+    /**
+     * Sets whether render() should interpolate particle positions between the
+     * previous and the current simulation step, based on the time left in the
+     * accumulator. This gives smooth motion when rendering at a different rate
+     * than the simulation runs at.
+     * 
+     * @param interpolate true to interpolate, false to render the last step.
+     */
+    void setInterpolation(bool interpolate);
+    
+    /**
+     * Sets the seed for the random numbers used to initialize particles. The
+     * same seed gives the same particles, also when simulating on multiple 
+     * threads. The seed takes effect on the next call to initialize(). By 
+     * default, a random seed is used.
+     * 
+     * @param seed The seed.
+     */
+    void setSeed(const GLuint& seed);
+    
+    /**
+     * Sets whether live particles are kept packed at the front of the storage.
+     * 
+     * When not compact (the default), every particle in the storage is 
+     * simulated and rendered, and dead particles are respawned right away.
+     * 
+     * When compact, the generator starts out empty. Particles are added using
+     * emit(), and dead particles are removed by moving the last live particle
+     * in their place. Simulating and rendering then only costs as much as the
+     * amount of live particles, not the maximum amount of particles. 
+     * 
+     * Takes effect on the next call to initialize().
+     * 
+     * @param compact true for compact, false otherwise.
+     */
+    void setCompact(bool compact);
+    
+    /**
+     * Adds new particles after the live particles, when compact. This does not
+     * touch any of the other particles, and fails when the generator is full.
+     * 
+     * @param count The amount of particles to add.
+     * @return The amount of particles added; 0 when the generator is not compact.
+     */
+    GLuint emit(const GLuint& count);
+    
+    /**
+     * Sets the amount of particles emitted continuously per second of 
+     * simulated time. Only used when compact. Defaults to 0.
+     * 
+     * @param rate The amount of particles per second.
+     */
+    void setEmissionRate(const GLfloat& rate);
+    
+    /**
+     * Adds a burst of particles to emit at a certain time. Only used when 
+     * compact. Times are relative to the last call to initialize().
+     * 
+     * @param burst The burst.
+     */
+    void addBurst(const ParticleBurst& burst);
+    
+    /**
+     * Removes all bursts.
+     */
+    void clearBursts();
+    
+    /**
+     * Sets the maximum amount of particles emitted by the emission rate and 
+     * bursts in a single step. Particles over the budget are emitted in the 
+     * following steps instead, which spreads the cost of big bursts over 
+     * multiple frames. Defaults to 0, meaning no limit.
+     * 
+     * @param budget The maximum amount of particles per step, or 0.
+     */
+    void setSpawnBudget(const GLuint& budget);
+    
+    /**
+     * Sets how to render the particles. Defaults to RENDER_BUFFER, which uses
+     * a buffer object when available (OpenGL 1.5), and plain vertex arrays
+     * otherwise. RENDER_INSTANCED writes a quarter of the data by letting the
+     * GPU expand every particle to a quad, but needs OpenGL 3.3 (or the 
+     * instancing extensions); without it, RENDER_BUFFER is used instead. 
+     * RENDER_IMMEDIATE is mostly useful for comparison.
+     * 
+     * @param mode The render mode.
+     */
+    void setRenderMode(const RenderMode& mode);
+    
     const GLfloat& getParticleLife() const;
     
+    const GLuint& getSeed() const;
+    
+    bool isCompact() const;
+    
+    /**
+     * Gets the amount of live particles. When compact, these are the particles
+     * at the front of the storage. When not compact, this is the same as the
+     * maximum amount of particles.
+     * 
+     * @return The amount of live particles.
+     */
+    const GLuint& getAliveCount() const;
+    
+    const GLfloat& getEmissionRate() const;
+    
+    const std::vector<ParticleBurst>& getBursts() const;
+    
+    const GLuint& getSpawnBudget() const;
+    
+    RenderMode getRenderMode() const;
+    
+    const double& getTimestep() const;
+    
+    const GLuint& getMaxSteps() const;
+    
+    bool isInterpolation() const;
+    
     /**
      * Returns the maximum amount of particles to be generated by this generator.
      * 
@@ -627,17 +1299,258 @@ public:
     /**
      * Gets the particle array. The pointer cannot be changed, the values in it
      * can be changed however. getMaxParticles() can be used to iterate over the
-     * array.
+     * array. 
+     * 
+     * Since the particles are kept in a ParticleStorage, the array is a copy 
+     * which is filled each time this function is called. Changes made to the 
+     * particles in the array only take effect after calling storeParticles().
      * 
      * @return The current array of particles.
      */
-    Particle* const getParticles() const;
+    Particle* const getParticles();
+    
+    /**
+     * Writes the particle array as returned by getParticles() back to the
+     * particle storage of this generator.
+     */
+    void storeParticles();
+    
+    /**
+     * Gets the storage with all the particles of this generator. After moving
+     * a particle through it, call extendBoundary() for it.
+     * 
+     * @return The particle storage.
+     */
+    ParticleStorage& getStorage();
+    
+    /**
+     * Grows the box around the particles returned by getBoundary3D() to 
+     * include the given particle, after it was changed through getStorage().
+     * The box is not shrunk, so it stays around all particles.
+     * 
+     * @param i The index of the particle in the storage.
+     */
+    void extendBoundary(const GLuint& i);
+
+    /**
+     * Advances the simulation by the given amount of time. The time is added
+     * to an accumulator, and step() is called for every full timestep in it,
+     * so the simulation speed does not depend on how often this is called.
+     * No OpenGL calls are made.
+     * 
+     * @param dt The time passed since the previous update, in seconds.
+     * @return The amount of steps simulated.
+     */
+    GLuint update(const double& dt);
+    
+    /**
+     * Same as update(const double&), but simulates the chunks of particles in
+     * parallel on the given pool. The results are the same.
+     * 
+     * @param dt The time passed since the previous update, in seconds.
+     * @param pool The pool to simulate on.
+     * @return The amount of steps simulated.
+     */
+    GLuint update(const double& dt, JobPool& pool);
+    
+    /**
+     * Adds the given amount of time to the accumulator, and takes out the
+     * amount of steps to simulate. Used by update(); only useful when driving
+     * the steps by hand, like ParticleUpdater does.
+     * 
+     * @param dt The time passed since the previous update, in seconds.
+     * @return The amount of steps to simulate.
+     */
+    GLuint advance(const double& dt);
+    
+    /**
+     * Simulates exactly one timestep: moves all live particles, applies their
+     * gravity and fade speed, and recolors them. Dead or inactive particles
+     * are respawned using initParticle(), or removed when compact. This runs
+     * stepChunk() for every chunk of particles, followed by finishStep().
+     */
+    void step();
+    
+    /**
+     * Queues the jobs for simulating one timestep on the given pool. After
+     * running the pool, finishStep() must be called to complete the step.
+     * 
+     * @param pool The pool to queue the jobs on.
+     */
+    void addStepJobs(JobPool& pool);
+    
+    /**
+     * Completes a step after all chunks are simulated. When compact, this
+     * removes the dead particles, and emits new ones according to the 
+     * emission rate, bursts and spawn budget. The boxes around the particles
+     * of the chunks are merged, for getBoundary3D().
+     */
+    void finishStep();
 
     /**
-     * Renders this particle generator and subsequently all its particles. Can
-     * be overridden by subclasses to provide their own rendering.
+     * Renders this particle generator and subsequently all its particles. This
+     * does not change the particles in any way; use update() or step() to 
+     * advance them. Can be overridden by subclasses to provide their own 
+     * rendering. No state is set; through a RenderQueue, the particles are
+     * drawn in the transparent pass, unlit and blended additively.
      */
     virtual void render();
+    
+    /**
+     * Gets the box around the live particles, as they are rendered: when 
+     * interpolating, the positions before the last step are included. When 
+     * there are no live particles, the box is empty, at the generator. 
+     * 
+     * The first call goes over all particles. From then on, the chunks put a
+     * box around their particles while stepping, in parallel, and emit() and
+     * extendBoundary() grow it. Only after initialize(), storeParticles() or
+     * setInterpolation() are all particles gone over again, once.
+     * 
+     * @return The box around the particles.
+     */
+    virtual const AABB3& getBoundary3D();
+    
+    /**
+     * Gets the box around the live particles like getBoundary3D(), without
+     * the z coordinate.
+     * 
+     * @return The rectangle around the particles.
+     */
+    virtual const Rect& getBoundary();
+    
+protected:
+    /**
+     * Simulates one timestep for a chunk of particles. Can be overridden by 
+     * subclasses to provide their own simulation. Chunks may be simulated in
+     * parallel, so this should only touch the particles in the given chunk.
+     * When compact, only particles below getAliveCount() should be simulated,
+     * and the indices of dead ones must be left in the chunk's dead list.
+     * 
+     * @param chunk The chunk to simulate.
+     */
+    virtual void stepChunk(ParticleChunk& chunk);
+    
+    /**
+     * Renders the live particles in immediate mode.
+     */
+    void renderImmediate();
+    
+    /**
+     * Renders the live particles from a vertex buffer.
+     */
+    void renderBuffer();
+    
+    /**
+     * Renders the live particles as instanced quads. Falls back to 
+     * renderBuffer() when instancing or shaders are not available.
+     */
+    void renderInstanced();
+    
+    /**
+     * Gets the random number generator to use for initializing particles. 
+     * While simulating a chunk, this is the chunk's generator, so it is safe
+     * to use from initParticle().
+     * 
+     * @return The random number generator.
+     */
+    Random& getRandom();
+    
+    /**
+     * Re-initializes the particle at index i of the storage, by passing it
+     * through initParticle().
+     * 
+     * @param i The index of the particle.
+     * @param scratch Particle to use as scratch space.
+     */
+    void respawnParticle(const GLuint& i, Particle& scratch);
+    
+    /**
+     * Finds out whether initParticle() is overridden, by calling it once on
+     * a scratch particle.
+     * 
+     * @param scratch Particle to use as scratch space.
+     * @return Whether initParticle() is the default implementation.
+     */
+    bool probeInitParticle(Particle& scratch);
+    
+    /**
+     * Re-initializes the particles in the range [begin, end) of the storage. 
+     * When initParticle() is not overridden, the random numbers for each
+     * attribute are generated straight into the storage at once.
+     * 
+     * @param begin The index of the first particle.
+     * @param end One past the index of the last particle.
+     * @param scratch Particle to use as scratch space.
+     */
+    void respawnParticles(const GLuint& begin, const GLuint& end, Particle& scratch);
+    
+    /**
+     * Re-initializes the particles at the given indices of the storage. When
+     * initParticle() is not overridden, the random numbers for each attribute
+     * are generated at once.
+     * 
+     * @param indices The indices of the particles, in increasing order.
+     * @param scratch Particle to use as scratch space.
+     * @param buffer Space for the random numbers.
+     */
+    void respawnParticles(const std::vector<GLuint>& indices, Particle& scratch, std::vector<GLfloat>& buffer);
+    
+    /**
+     * Computes the box around the live particles of a chunk, after its step.
+     * 
+     * @param chunk The chunk.
+     */
+    void boundChunk(ParticleChunk& chunk);
+    
+    /**
+     * Computes the box around the live particles, by going over all of them.
+     */
+    void updateBoundary();
+};
+
+//==============================================================================
+
+/**
+ * Updates a set of particle generators together on a JobPool. The chunks of 
+ * all generators are simulated in parallel, so a scene with many small 
+ * generators uses all threads as well as a scene with one big generator.
+ */
+class ParticleUpdater {
+private:
+    /// The pool to simulate on.
+    JobPool& m_pool;
+    
+    /// The generators to update.
+    std::vector<ParticleGenerator*> m_generators;
+    
+    /// Amount of steps to simulate per generator, during update().
+    std::vector<GLuint> m_steps;
+
+public:
+    /**
+     * Creates an updater.
+     * 
+     * @param pool The pool to simulate on.
+     */
+    ParticleUpdater(JobPool& pool);
+    
+    ~ParticleUpdater();
+    
+    /**
+     * Adds a generator to update. The updater does not take ownership.
+     * 
+     * @param generator The generator.
+     */
+    void addGenerator(ParticleGenerator* const generator);
+    
+    /**
+     * Advances all generators by the given amount of time. Generators with 
+     * different timesteps each simulate their own amount of steps.
+     * 
+     * @param dt The time passed since the previous update, in seconds.
+     * @return The largest amount of steps simulated by a generator.
+     */
+    GLuint update(const double& dt);
 };
 
 }
@@ -0,0 +1,85 @@
+//      frustum.cpp
+//      
+//      Copyright 2010 Kevin Pors <krpors@users.sf.net>
+//      
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//      
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//      
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//      MA 02110-1301, USA.
+
+#include "frustum.hpp"
+
+namespace ogle {
+
+Frustum::Frustum() {
+    // planes without a normal have every point inside.
+    for(GLuint i = 0; i < 6; i++) {
+        m_planes[i].normal = Vec3();
+        m_planes[i].distance = 0.0f;
+    }
+}
+
+Frustum::~Frustum() {
+}
+
+void Frustum::extract() {
+    GLfloat projection[16];
+    GLfloat modelview[16];
+    glGetFloatv(GL_PROJECTION_MATRIX, projection);
+    glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
+    extract(projection, modelview);
+}
+
+void Frustum::extract(const GLfloat* projection, const GLfloat* modelview) {
+    // clip = projection * modelview, both column major: element (row, col)
+    // is at [col * 4 + row].
+    GLfloat clip[16];
+    for(GLuint col = 0; col < 4; col++) {
+        for(GLuint row = 0; row < 4; row++) {
+            GLfloat sum = 0.0f;
+            for(GLuint k = 0; k < 4; k++) {
+                sum += projection[k * 4 + row] * modelview[col * 4 + k];
+            }
+            clip[col * 4 + row] = sum;
+        }
+    }
+    
+    // a point is inside when -w <= x, y, z <= w in clip space, which gives a
+    // plane per side: the last row plus or minus the row of that axis.
+    for(GLuint i = 0; i < 6; i++) {
+        const GLuint axis = i / 2;
+        const GLfloat sign = (i % 2 == 0) ? 1.0f : -1.0f;
+        Plane& plane = m_planes[i];
+        plane.normal = Vec3(clip[0 * 4 + 3] + sign * clip[0 * 4 + axis],
+                            clip[1 * 4 + 3] + sign * clip[1 * 4 + axis],
+                            clip[2 * 4 + 3] + sign * clip[2 * 4 + axis]);
+        plane.distance = clip[3 * 4 + 3] + sign * clip[3 * 4 + axis];
+    }
+}
+
+bool Frustum::intersects(const AABB3& box) const {
+    for(GLuint i = 0; i < 6; i++) {
+        const Plane& plane = m_planes[i];
+        // the corner of the box furthest along the normal of the plane. If 
+        // even that one is outside, the whole box is.
+        const Vec3 corner(plane.normal.x >= 0.0f ? box.x + box.w : box.x,
+                          plane.normal.y >= 0.0f ? box.y + box.h : box.y,
+                          plane.normal.z >= 0.0f ? box.z + box.d : box.z);
+        if(dot(plane.normal, corner) + plane.distance < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace ogle
@@ -0,0 +1,83 @@
+//      frustum.hpp
+//      
+//      Copyright 2010 Kevin Pors <krpors@users.sf.net>
+//      
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//      
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//      
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//      MA 02110-1301, USA.
+
+#ifndef FRUSTUM_HPP
+#define FRUSTUM_HPP
+
+#include "core.hpp"
+#include "vec3.hpp"
+
+#include <GL/gl.h>
+
+namespace ogle {
+
+/**
+ * The part of the world which is visible to the camera, bounded by six 
+ * planes: left, right, bottom, top, near and far. The planes are extracted 
+ * from the projection and modelview matrices, so they are in world 
+ * coordinates, like the boundaries of objects.
+ */
+class Frustum {
+private:
+    /// A plane: points p for which dot(normal, p) + distance >= 0 are inside.
+    struct Plane {
+        Vec3 normal;
+        GLfloat distance;
+    };
+    
+    /// The planes, in the order left, right, bottom, top, near and far.
+    Plane m_planes[6];
+    
+public:
+    /**
+     * Creates a frustum containing everything, until extract() is called.
+     */
+    Frustum();
+    
+    ~Frustum();
+    
+    /**
+     * Extracts the planes from the current projection and modelview matrices
+     * of OpenGL.
+     */
+    void extract();
+    
+    /**
+     * Extracts the planes from the given matrices, in the column major order
+     * of glGetFloatv().
+     * 
+     * @param projection The projection matrix.
+     * @param modelview The modelview matrix.
+     */
+    void extract(const GLfloat* projection, const GLfloat* modelview);
+    
+    /**
+     * Checks whether a box is at least partly inside this frustum. This is 
+     * conservative: boxes near the corners of the frustum may be reported as
+     * visible while they are not, but visible boxes are never missed.
+     * 
+     * @param box The box, in world coordinates.
+     * @return false when the box is completely outside.
+     */
+    bool intersects(const AABB3& box) const;
+};
+
+} // namespace ogle
+
+#endif // FRUSTUM_HPP
@@ -0,0 +1,194 @@
+//      glext.cpp
+//      
+//      Copyright 2010 Kevin Pors <krpors@users.sf.net>
+//      
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//      
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//      
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//      MA 02110-1301, USA.
+
+#include "glext.hpp"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <GL/glx.h>
+#endif
+
+namespace ogle {
+
+bool GLExtensions::s_loaded        = false;
+bool GLExtensions::s_bufferObjects = false;
+bool GLExtensions::s_shaders       = false;
+bool GLExtensions::s_instancing    = false;
+
+PFNGLGENBUFFERSPROC     GLExtensions::genBuffers    = NULL;
+PFNGLDELETEBUFFERSPROC  GLExtensions::deleteBuffers = NULL;
+PFNGLBINDBUFFERPROC     GLExtensions::bindBuffer    = NULL;
+PFNGLBUFFERDATAPROC     GLExtensions::bufferData    = NULL;
+PFNGLBUFFERSUBDATAPROC  GLExtensions::bufferSubData = NULL;
+PFNGLMAPBUFFERPROC      GLExtensions::mapBuffer     = NULL;
+PFNGLUNMAPBUFFERPROC    GLExtensions::unmapBuffer   = NULL;
+
+PFNGLCREATESHADERPROC               GLExtensions::createShader             = NULL;
+PFNGLDELETESHADERPROC               GLExtensions::deleteShader             = NULL;
+PFNGLSHADERSOURCEPROC               GLExtensions::shaderSource             = NULL;
+PFNGLCOMPILESHADERPROC              GLExtensions::compileShader            = NULL;
+PFNGLGETSHADERIVPROC                GLExtensions::getShaderiv              = NULL;
+PFNGLGETSHADERINFOLOGPROC           GLExtensions::getShaderInfoLog         = NULL;
+PFNGLCREATEPROGRAMPROC              GLExtensions::createProgram            = NULL;
+PFNGLDELETEPROGRAMPROC              GLExtensions::deleteProgram            = NULL;
+PFNGLATTACHSHADERPROC               GLExtensions::attachShader             = NULL;
+PFNGLBINDATTRIBLOCATIONPROC         GLExtensions::bindAttribLocation       = NULL;
+PFNGLLINKPROGRAMPROC                GLExtensions::linkProgram              = NULL;
+PFNGLGETPROGRAMIVPROC               GLExtensions::getProgramiv             = NULL;
+PFNGLGETPROGRAMINFOLOGPROC          GLExtensions::getProgramInfoLog        = NULL;
+PFNGLUSEPROGRAMPROC                 GLExtensions::useProgram               = NULL;
+PFNGLGETUNIFORMLOCATIONPROC         GLExtensions::getUniformLocation       = NULL;
+PFNGLUNIFORM1IPROC                  GLExtensions::uniform1i                = NULL;
+PFNGLUNIFORM4FVPROC                 GLExtensions::uniform4fv               = NULL;
+PFNGLVERTEXATTRIBPOINTERPROC        GLExtensions::vertexAttribPointer      = NULL;
+PFNGLENABLEVERTEXATTRIBARRAYPROC    GLExtensions::enableVertexAttribArray  = NULL;
+PFNGLDISABLEVERTEXATTRIBARRAYPROC   GLExtensions::disableVertexAttribArray = NULL;
+
+PFNGLVERTEXATTRIBDIVISORPROC        GLExtensions::vertexAttribDivisor      = NULL;
+PFNGLDRAWARRAYSINSTANCEDPROC        GLExtensions::drawArraysInstanced      = NULL;
+
+/**
+ * Looks up a single entry point.
+ * 
+ * @param name The name of the function.
+ * @return The function, or NULL if it doesn't exist.
+ */
+static void* lookup(const char* name) {
+#ifdef _WIN32
+    return reinterpret_cast<void*>(wglGetProcAddress(name));
+#else
+    return reinterpret_cast<void*>(glXGetProcAddressARB(reinterpret_cast<const GLubyte*>(name)));
+#endif
+}
+
+/**
+ * Looks up a single entry point, and casts it to the type of the pointer to
+ * store it in.
+ */
+template <typename T>
+static bool lookup(T& function, const char* name) {
+    function = reinterpret_cast<T>(lookup(name));
+    return function != NULL;
+}
+
+void GLExtensions::load() {
+    if(s_loaded) {
+        return;
+    }
+    // without a current context there is no version; try again next time, 
+    // instead of reporting everything as unavailable for good.
+    if(glGetString(GL_VERSION) == NULL) {
+        return;
+    }
+    s_loaded = true;
+    
+    if(hasVersion(1, 5)) {
+        s_bufferObjects = 
+            lookup(genBuffers,    "glGenBuffers") &&
+            lookup(deleteBuffers, "glDeleteBuffers") &&
+            lookup(bindBuffer,    "glBindBuffer") &&
+            lookup(bufferData,    "glBufferData") &&
+            lookup(bufferSubData, "glBufferSubData") &&
+            lookup(mapBuffer,     "glMapBuffer") &&
+            lookup(unmapBuffer,   "glUnmapBuffer");
+    }
+    
+    if(hasVersion(2, 0)) {
+        s_shaders = 
+            lookup(createShader,             "glCreateShader") &&
+            lookup(deleteShader,             "glDeleteShader") &&
+            lookup(shaderSource,             "glShaderSource") &&
+            lookup(compileShader,            "glCompileShader") &&
+            lookup(getShaderiv,              "glGetShaderiv") &&
+            lookup(getShaderInfoLog,         "glGetShaderInfoLog") &&
+            lookup(createProgram,            "glCreateProgram") &&
+            lookup(deleteProgram,            "glDeleteProgram") &&
+            lookup(attachShader,             "glAttachShader") &&
+            lookup(bindAttribLocation,       "glBindAttribLocation") &&
+            lookup(linkProgram,              "glLinkProgram") &&
+            lookup(getProgramiv,             "glGetProgramiv") &&
+            lookup(getProgramInfoLog,        "glGetProgramInfoLog") &&
+            lookup(useProgram,               "glUseProgram") &&
+            lookup(getUniformLocation,       "glGetUniformLocation") &&
+            lookup(uniform1i,                "glUniform1i") &&
+            lookup(uniform4fv,               "glUniform4fv") &&
+            lookup(vertexAttribPointer,      "glVertexAttribPointer") &&
+            lookup(enableVertexAttribArray,  "glEnableVertexAttribArray") &&
+            lookup(disableVertexAttribArray, "glDisableVertexAttribArray");
+    }
+    
+    if(s_bufferObjects && s_shaders) {
+        if(hasVersion(3, 3)) {
+            s_instancing = 
+                lookup(vertexAttribDivisor, "glVertexAttribDivisor") &&
+                lookup(drawArraysInstanced, "glDrawArraysInstanced");
+        } else if(hasExtension("GL_ARB_instanced_arrays") && hasExtension("GL_ARB_draw_instanced")) {
+            s_instancing = 
+                lookup(vertexAttribDivisor, "glVertexAttribDivisorARB") &&
+                lookup(drawArraysInstanced, "glDrawArraysInstancedARB");
+        }
+    }
+}
+
+bool GLExtensions::hasVersion(const int& major, const int& minor) {
+    const char* version = reinterpret_cast<const char*>(glGetString(GL_VERSION));
+    int ma = 0;
+    int mi = 0;
+    if(version == NULL || sscanf(version, "%d.%d", &ma, &mi) != 2) {
+        return false;
+    }
+    return ma > major || (ma == major && mi >= minor);
+}
+
+bool GLExtensions::hasBufferObjects() {
+    return s_bufferObjects;
+}
+
+bool GLExtensions::hasExtension(const char* name) {
+    const char* extensions = reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS));
+    if(extensions == NULL) {
+        return false;
+    }
+    // look for the whole word, not just a prefix of another extension.
+    const size_t length = strlen(name);
+    const char* found = extensions;
+    while((found = strstr(found, name)) != NULL) {
+        bool start = found == extensions || found[-1] == ' ';
+        bool end   = found[length] == ' ' || found[length] == '\0';
+        if(start && end) {
+            return true;
+        }
+        found += length;
+    }
+    return false;
+}
+
+bool GLExtensions::hasShaders() {
+    return s_shaders;
+}
+
+bool GLExtensions::hasInstancing() {
+    return s_instancing;
+}
+
+} // namespace ogle
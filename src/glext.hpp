@@ -0,0 +1,136 @@
+//      glext.hpp
+//      
+//      Copyright 2010 Kevin Pors <krpors@users.sf.net>
+//      
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//      
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//      
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//      MA 02110-1301, USA.
+
+#ifndef GLEXT_HPP
+#define GLEXT_HPP
+
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+namespace ogle {
+
+/**
+ * Entry points of the OpenGL functions beyond OpenGL 1.1 which Ogle uses. On
+ * most platforms these can't be linked against directly, and have to be looked
+ * up at runtime instead, with a current OpenGL context. Call load() once a 
+ * context exists; until then, all features are reported as unavailable.
+ */
+class GLExtensions {
+private:
+    /// Whether load() has been called with a current context.
+    static bool s_loaded;
+    
+    /// Whether buffer objects (OpenGL 1.5) are available.
+    static bool s_bufferObjects;
+    
+    /// Whether shaders (OpenGL 2.0) are available.
+    static bool s_shaders;
+    
+    /// Whether instanced drawing (OpenGL 3.3 or ARB_instanced_arrays) is available.
+    static bool s_instancing;
+    
+public:
+    /**
+     * Looks up all entry points. Needs a current OpenGL context; without one
+     * this does nothing, so it can be called again once there is a context.
+     * After a successful call, calling this again does nothing.
+     */
+    static void load();
+    
+    /**
+     * Checks whether the OpenGL version of the current context is at least 
+     * the given version.
+     * 
+     * @param major The major version number.
+     * @param minor The minor version number.
+     * @return true if the version is at least major.minor.
+     */
+    static bool hasVersion(const int& major, const int& minor);
+    
+    /**
+     * Checks whether buffer objects (OpenGL 1.5) can be used.
+     * 
+     * @return true if available.
+     */
+    static bool hasBufferObjects();
+    
+    /**
+     * Checks whether the current context supports the given extension.
+     * 
+     * @param name The name of the extension, e.g. "GL_ARB_instanced_arrays".
+     * @return true if supported.
+     */
+    static bool hasExtension(const char* name);
+    
+    /**
+     * Checks whether shaders (OpenGL 2.0) can be used.
+     * 
+     * @return true if available.
+     */
+    static bool hasShaders();
+    
+    /**
+     * Checks whether instanced drawing with per instance vertex attributes
+     * can be used (OpenGL 3.3, or ARB_draw_instanced with ARB_instanced_arrays).
+     * Implies buffer objects and shaders.
+     * 
+     * @return true if available.
+     */
+    static bool hasInstancing();
+    
+    // OpenGL 1.5, buffer objects:
+    static PFNGLGENBUFFERSPROC      genBuffers;
+    static PFNGLDELETEBUFFERSPROC   deleteBuffers;
+    static PFNGLBINDBUFFERPROC      bindBuffer;
+    static PFNGLBUFFERDATAPROC      bufferData;
+    static PFNGLBUFFERSUBDATAPROC   bufferSubData;
+    static PFNGLMAPBUFFERPROC       mapBuffer;
+    static PFNGLUNMAPBUFFERPROC     unmapBuffer;
+    
+    // OpenGL 2.0, shaders:
+    static PFNGLCREATESHADERPROC            createShader;
+    static PFNGLDELETESHADERPROC            deleteShader;
+    static PFNGLSHADERSOURCEPROC            shaderSource;
+    static PFNGLCOMPILESHADERPROC           compileShader;
+    static PFNGLGETSHADERIVPROC             getShaderiv;
+    static PFNGLGETSHADERINFOLOGPROC        getShaderInfoLog;
+    static PFNGLCREATEPROGRAMPROC           createProgram;
+    static PFNGLDELETEPROGRAMPROC           deleteProgram;
+    static PFNGLATTACHSHADERPROC            attachShader;
+    static PFNGLBINDATTRIBLOCATIONPROC      bindAttribLocation;
+    static PFNGLLINKPROGRAMPROC             linkProgram;
+    static PFNGLGETPROGRAMIVPROC            getProgramiv;
+    static PFNGLGETPROGRAMINFOLOGPROC       getProgramInfoLog;
+    static PFNGLUSEPROGRAMPROC              useProgram;
+    static PFNGLGETUNIFORMLOCATIONPROC      getUniformLocation;
+    static PFNGLUNIFORM1IPROC               uniform1i;
+    static PFNGLUNIFORM4FVPROC              uniform4fv;
+    static PFNGLVERTEXATTRIBPOINTERPROC     vertexAttribPointer;
+    static PFNGLENABLEVERTEXATTRIBARRAYPROC enableVertexAttribArray;
+    static PFNGLDISABLEVERTEXATTRIBARRAYPROC disableVertexAttribArray;
+    
+    // OpenGL 3.3, instancing:
+    static PFNGLVERTEXATTRIBDIVISORPROC     vertexAttribDivisor;
+    static PFNGLDRAWARRAYSINSTANCEDPROC     drawArraysInstanced;
+};
+
+} // namespace ogle
+
+
+#endif // GLEXT_HPP
@@ -0,0 +1,224 @@
+//      headless.cpp
+//      
+//      Copyright 2010 Kevin Pors <krpors@users.sf.net>
+//      
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//      
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//      
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//      MA 02110-1301, USA.
+
+/*
+ * Runs the particle simulation and collision detection without a window, for
+ * a fixed amount of steps and as fast as possible, and reports the throughput.
+ * No OpenGL calls are made, so this runs on machines without a display.
+ */
+
+#include "core.hpp"
+#include "collision.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+
+/// Distance between the generators, which is also the width of their bounds.
+const GLfloat GENERATOR_SPACING = 50.0f;
+
+/**
+ * Settings of a single run, taken from the command line.
+ */
+struct Settings {
+    /// Amount of steps to simulate.
+    GLuint steps;
+
+    /// Amount of generators.
+    GLuint generators;
+
+    /// Particles per generator.
+    GLuint particles;
+
+    /// Threads to simulate on, or 0 for the amount of processors.
+    GLuint threads;
+
+    /// The broadphase: "none", "hash" or "sap".
+    const char* broadphase;
+
+    /// Whether to check collisions at all.
+    bool collisions;
+
+    /// Seed of the first generator.
+    GLuint seed;
+};
+
+void printUsage(const char* name) {
+    std::cout << "Usage: " << name << " [options]" << std::endl
+              << "  -s <steps>      steps to simulate (default 1000)" << std::endl
+              << "  -g <count>      amount of generators (default 1)" << std::endl
+              << "  -p <count>      particles per generator (default 10000)" << std::endl
+              << "  -t <threads>    threads, 0 for all processors (default 0)" << std::endl
+              << "  -b <name>       broadphase: none, hash or sap (default sap)" << std::endl
+              << "  -r <seed>       seed of the first generator (default 1)" << std::endl
+              << "  -n              no collision detection" << std::endl
+              << "  -h              show this help" << std::endl;
+}
+
+/**
+ * Parses the command line into the settings.
+ *
+ * @return false when the program should exit.
+ */
+bool parseArguments(int argc, char* argv[], Settings& settings) {
+    for(int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if(strcmp(arg, "-n") == 0) {
+            settings.collisions = false;
+        } else if(strcmp(arg, "-h") == 0) {
+            printUsage(argv[0]);
+            return false;
+        } else if(hasValue && strcmp(arg, "-s") == 0) {
+            settings.steps = atoi(argv[++i]);
+        } else if(hasValue && strcmp(arg, "-g") == 0) {
+            settings.generators = atoi(argv[++i]);
+        } else if(hasValue && strcmp(arg, "-p") == 0) {
+            settings.particles = atoi(argv[++i]);
+        } else if(hasValue && strcmp(arg, "-t") == 0) {
+            settings.threads = atoi(argv[++i]);
+        } else if(hasValue && strcmp(arg, "-b") == 0) {
+            settings.broadphase = argv[++i];
+        } else if(hasValue && strcmp(arg, "-r") == 0) {
+            settings.seed = atoi(argv[++i]);
+        } else {
+            std::cerr << "Unknown or incomplete option: " << arg << std::endl;
+            printUsage(argv[0]);
+            return false;
+        }
+    }
+
+    if(strcmp(settings.broadphase, "none") != 0 &&
+       strcmp(settings.broadphase, "hash") != 0 &&
+       strcmp(settings.broadphase, "sap") != 0) {
+        std::cerr << "Unknown broadphase: " << settings.broadphase << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Creates the broadphase with the given name.
+ *
+ * @return The broadphase, or NULL for "none".
+ */
+ogle::Broadphase* createBroadphase(const char* name) {
+    if(strcmp(name, "hash") == 0) {
+        return new ogle::SpatialHash();
+    }
+    if(strcmp(name, "sap") == 0) {
+        return new ogle::SweepAndPrune();
+    }
+    return NULL;
+}
+
+int main(int argc, char* argv[]) {
+    Settings settings;
+    settings.steps      = 1000;
+    settings.generators = 1;
+    settings.particles  = 10000;
+    settings.threads    = 0;
+    settings.broadphase = "sap";
+    settings.collisions = true;
+    settings.seed       = 1;
+
+    if(!parseArguments(argc, argv, settings)) {
+        return EXIT_FAILURE;
+    }
+
+    ogle::JobPool pool(settings.threads);
+    ogle::ParticleUpdater updater(pool);
+
+    // generators side by side, each with a fountain of particles.
+    std::vector<ogle::ParticleGenerator*> generators;
+    for(GLuint i = 0; i < settings.generators; i++) {
+        ogle::ParticleGenerator* generator = new ogle::ParticleGenerator(i * GENERATOR_SPACING, 0.0f);
+        generator->setSeed(settings.seed + i);
+        generator->setSpreadX(-0.5f, 0.5f);
+        generator->setSpreadY(0.2f, 1.0f);
+        generator->setSpreadGravity(-0.02f, -0.01f);
+        generator->setSpreadFade(-0.02f, -0.005f);
+        generator->setParticleLife(1.0f);
+        generator->setMaxParticles(settings.particles);
+        generator->initialize();
+        generators.push_back(generator);
+        updater.addGenerator(generator);
+    }
+
+    // every generator needs its own broadphase, since broadphases keep state.
+    std::vector<ogle::CollisionDetector*> detectors;
+    std::vector<ogle::Broadphase*> broadphases;
+    for(GLuint i = 0; settings.collisions && i < settings.generators; i++) {
+        ogle::Broadphase* broadphase = createBroadphase(settings.broadphase);
+        broadphases.push_back(broadphase);
+        // the bounds are given as (left, bottom) - (right, top).
+        const GLfloat x = i * GENERATOR_SPACING;
+        const GLfloat half = GENERATOR_SPACING / 2.0f;
+        ogle::CollisionDetector* detector = new ogle::CollisionDetector(ogle::Rect(x - half, -half, x + half, 2.0f * half), broadphase);
+        detector->setJobPool(&pool);
+        detector->setBoundsResponse(true);
+        detectors.push_back(detector);
+    }
+
+    // a step at a time, so collisions are checked after every step.
+    const double timestep = generators.empty() ? 0.0 : generators[0]->getTimestep();
+    double particleSteps = 0.0;
+    float simulation = 0.0f;
+    float collision = 0.0f;
+    sf::Clock clock;
+    for(GLuint step = 0; step < settings.steps; step++) {
+        clock.Reset();
+        updater.update(timestep);
+        simulation += clock.GetElapsedTime();
+
+        clock.Reset();
+        for(size_t i = 0; i < detectors.size(); i++) {
+            detectors[i]->checkCollisions(*generators[i]);
+        }
+        collision += clock.GetElapsedTime();
+
+        for(size_t i = 0; i < generators.size(); i++) {
+            particleSteps += generators[i]->getAliveCount();
+        }
+    }
+
+    const double total = simulation + collision;
+    std::cout << std::fixed << std::setprecision(2)
+              << "generators:      " << settings.generators << " x " << settings.particles << " particles" << std::endl
+              << "threads:         " << pool.getThreadCount() << std::endl
+              << "broadphase:      " << (settings.collisions ? settings.broadphase : "no collisions") << std::endl
+              << "steps:           " << settings.steps << " in " << total << " s" << std::endl
+              << "simulation:      " << (settings.steps > 0 ? 1000.0 * simulation / settings.steps : 0.0) << " ms/step" << std::endl
+              << "collision:       " << (settings.steps > 0 ? 1000.0 * collision / settings.steps : 0.0) << " ms/step" << std::endl
+              << "steps/sec:       " << (total > 0.0 ? settings.steps / total : 0.0) << std::endl
+              << "particles/sec:   " << (total > 0.0 ? particleSteps / total : 0.0) << std::endl;
+
+    for(size_t i = 0; i < detectors.size(); i++) {
+        delete detectors[i];
+    }
+    for(size_t i = 0; i < broadphases.size(); i++) {
+        delete broadphases[i];
+    }
+    for(size_t i = 0; i < generators.size(); i++) {
+        delete generators[i];
+    }
+
+    return EXIT_SUCCESS;
+}
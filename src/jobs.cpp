@@ -0,0 +1,249 @@
+//      jobs.cpp
+//      
+//      Copyright 2010 Kevin Pors <krpors@users.sf.net>
+//      
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//      
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//      
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//      MA 02110-1301, USA.
+
+#include "jobs.hpp"
+
+#ifdef _WIN32
+#define NOMINMAX
+// condition variables are available since Windows Vista.
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT 0x0600
+#endif
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+namespace ogle {
+
+Job::Job() {
+}
+
+Job::~Job() {
+}
+
+//==============================================================================
+
+#ifdef _WIN32
+
+struct Condition::Handle {
+    CRITICAL_SECTION mutex;
+    CONDITION_VARIABLE condition;
+};
+
+Condition::Condition() :
+        m_handle(new Handle) {
+    InitializeCriticalSection(&m_handle->mutex);
+    InitializeConditionVariable(&m_handle->condition);
+}
+
+Condition::~Condition() {
+    DeleteCriticalSection(&m_handle->mutex);
+    delete m_handle;
+}
+
+void Condition::lock() {
+    EnterCriticalSection(&m_handle->mutex);
+}
+
+void Condition::unlock() {
+    LeaveCriticalSection(&m_handle->mutex);
+}
+
+void Condition::wait() {
+    SleepConditionVariableCS(&m_handle->condition, &m_handle->mutex, INFINITE);
+}
+
+void Condition::notifyAll() {
+    WakeAllConditionVariable(&m_handle->condition);
+}
+
+#else
+
+struct Condition::Handle {
+    pthread_mutex_t mutex;
+    pthread_cond_t condition;
+};
+
+Condition::Condition() :
+        m_handle(new Handle) {
+    pthread_mutex_init(&m_handle->mutex, NULL);
+    pthread_cond_init(&m_handle->condition, NULL);
+}
+
+Condition::~Condition() {
+    pthread_cond_destroy(&m_handle->condition);
+    pthread_mutex_destroy(&m_handle->mutex);
+    delete m_handle;
+}
+
+void Condition::lock() {
+    pthread_mutex_lock(&m_handle->mutex);
+}
+
+void Condition::unlock() {
+    pthread_mutex_unlock(&m_handle->mutex);
+}
+
+void Condition::wait() {
+    pthread_cond_wait(&m_handle->condition, &m_handle->mutex);
+}
+
+void Condition::notifyAll() {
+    pthread_cond_broadcast(&m_handle->condition);
+}
+
+#endif
+
+//==============================================================================
+
+JobPool::Worker::Worker(JobPool& pool) :
+        m_pool(pool) {
+}
+
+JobPool::Worker::~Worker() {
+}
+
+void JobPool::Worker::Run() {
+    m_pool.serve();
+}
+
+//==============================================================================
+
+JobPool::JobPool(const unsigned int& threads) :
+        m_next(0),
+        m_run(0),
+        m_joining(0),
+        m_busy(0),
+        m_stopping(false) {
+    unsigned int count = threads > 0 ? threads : getProcessorCount();
+    // the thread calling run() is a worker as well.
+    for(unsigned int i = 1; i < count; i++) {
+        m_workers.push_back(new Worker(*this));
+        m_workers.back()->Launch();
+    }
+}
+
+JobPool::~JobPool() {
+    m_condition.lock();
+    m_stopping = true;
+    m_condition.notifyAll();
+    m_condition.unlock();
+    
+    std::vector<Worker*>::iterator it;
+    for(it = m_workers.begin(); it < m_workers.end(); it++) {
+        (*it)->Wait();
+        delete *it;
+    }
+}
+
+Job* JobPool::next() {
+    sf::Lock lock(m_mutex);
+    if(m_next < m_jobs.size()) {
+        return m_jobs[m_next++];
+    }
+    return NULL;
+}
+
+void JobPool::work() {
+    Job* job;
+    while((job = next()) != NULL) {
+        job->execute();
+    }
+}
+
+void JobPool::serve() {
+    unsigned int run = 0;
+    
+    m_condition.lock();
+    while(true) {
+        while(m_run == run && !m_stopping) {
+            m_condition.wait();
+        }
+        if(m_stopping) {
+            break;
+        }
+        run = m_run;
+        
+        // workers which are not needed for this run go back to sleep.
+        if(m_joining == 0) {
+            continue;
+        }
+        m_joining--;
+        
+        m_condition.unlock();
+        work();
+        m_condition.lock();
+        
+        if(--m_busy == 0) {
+            m_condition.notifyAll();
+        }
+    }
+    m_condition.unlock();
+}
+
+void JobPool::add(Job* const job) {
+    m_jobs.push_back(job);
+}
+
+void JobPool::run() {
+    m_next = 0;
+    
+    // no need to wake more workers than there are jobs left for them, after
+    // the calling thread took one.
+    size_t wake = m_jobs.empty() ? 0 : std::min(m_workers.size(), m_jobs.size() - 1);
+    if(wake > 0) {
+        m_condition.lock();
+        m_joining = wake;
+        m_busy = wake;
+        m_run++;
+        m_condition.notifyAll();
+        m_condition.unlock();
+    }
+    
+    work();
+    
+    if(wake > 0) {
+        m_condition.lock();
+        while(m_busy > 0) {
+            m_condition.wait();
+        }
+        m_condition.unlock();
+    }
+    
+    m_jobs.clear();
+}
+
+unsigned int JobPool::getThreadCount() const {
+    return m_workers.size() + 1;
+}
+
+unsigned int JobPool::getProcessorCount() {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    long count = info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return count > 0 ? static_cast<unsigned int>(count) : 1;
+}
+
+} // namespace ogle
@@ -0,0 +1,227 @@
+//      jobs.hpp
+//      
+//      Copyright 2010 Kevin Pors <krpors@users.sf.net>
+//      
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//      
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//      
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//      MA 02110-1301, USA.
+
+#ifndef JOBS_HPP
+#define JOBS_HPP
+
+#include <SFML/System.hpp>
+
+#include <vector>
+#include <algorithm>
+
+/**
+ * Storage class for variables which have a separate instance per thread.
+ * Only usable for plain old data, like pointers.
+ */
+#if defined(_MSC_VER)
+#define OGLE_THREAD_LOCAL __declspec(thread)
+#else
+#define OGLE_THREAD_LOCAL __thread
+#endif
+
+namespace ogle {
+
+/**
+ * A unit of work which can be executed by a JobPool. Jobs executed in the same
+ * run of a pool may run in parallel, so they should not touch shared state.
+ */
+class Job {
+public:
+    Job();
+    
+    virtual ~Job();
+    
+    /**
+     * Does the work of this job.
+     */
+    virtual void execute() = 0;
+};
+
+//==============================================================================
+
+/**
+ * A condition variable with its own mutex, which SFML does not provide. Wraps
+ * pthreads, or the condition variables of Windows Vista and later.
+ */
+class Condition {
+private:
+    /// The platform specific mutex and condition variable.
+    struct Handle;
+    
+    /// The handle, hidden to keep the platform headers out of this header.
+    Handle* m_handle;
+    
+    Condition(const Condition&);
+    
+    Condition& operator=(const Condition&);
+    
+public:
+    Condition();
+    
+    ~Condition();
+    
+    /**
+     * Locks the mutex.
+     */
+    void lock();
+    
+    /**
+     * Unlocks the mutex.
+     */
+    void unlock();
+    
+    /**
+     * Unlocks the mutex and waits until notified, after which the mutex is
+     * locked again. The mutex must be locked by the calling thread. Waiting
+     * may end without a notification, so the caller should check its
+     * condition in a loop.
+     */
+    void wait();
+    
+    /**
+     * Wakes all threads waiting on this condition.
+     */
+    void notifyAll();
+};
+
+//==============================================================================
+
+/**
+ * A pool of worker threads which executes jobs in parallel. Jobs are queued 
+ * using add(), and executed by run(), which returns when all jobs are done.
+ * The calling thread helps executing jobs as well.
+ * 
+ * The worker threads are launched once by the constructor, and wait on a
+ * condition between runs. Each run() wakes only as many of them as there are
+ * jobs left for them.
+ */
+class JobPool {
+private:
+    /**
+     * Worker thread, which executes the jobs of each run until the pool is
+     * destroyed.
+     */
+    class Worker : public sf::Thread {
+    private:
+        /// The pool to take the jobs from.
+        JobPool& m_pool;
+        
+        virtual void Run();
+        
+    public:
+        Worker(JobPool& pool);
+        
+        ~Worker();
+    };
+    
+    friend class Worker;
+    
+    /// The worker threads, not counting the calling thread.
+    std::vector<Worker*> m_workers;
+    
+    /// Jobs queued for the next run.
+    std::vector<Job*> m_jobs;
+    
+    /// Index of the next job to execute.
+    size_t m_next;
+    
+    /// Guards m_next.
+    sf::Mutex m_mutex;
+    
+    /// Guards and signals changes of the members below.
+    Condition m_condition;
+    
+    /// Incremented by each run(), to wake the workers.
+    unsigned int m_run;
+    
+    /// The amount of workers which still have to join the current run.
+    size_t m_joining;
+    
+    /// The amount of workers which have not finished the current run.
+    size_t m_busy;
+    
+    /// Whether the workers should exit.
+    bool m_stopping;
+    
+    /**
+     * Takes the next job to execute.
+     * 
+     * @return The job, or NULL when all jobs are taken.
+     */
+    Job* next();
+    
+    /**
+     * Executes jobs until there are none left.
+     */
+    void work();
+    
+    /**
+     * Waits for the next run and executes its jobs, until the pool is
+     * destroyed. Executed by each worker thread.
+     */
+    void serve();
+    
+public:
+    /**
+     * Creates a job pool.
+     * 
+     * @param threads The amount of threads to execute jobs on, including the
+     *  thread calling run(). When 0, the amount of processors is used.
+     */
+    JobPool(const unsigned int& threads = 0);
+    
+    /**
+     * Destroys the pool and its worker threads.
+     */
+    ~JobPool();
+    
+    /**
+     * Queues a job for the next run. The pool does not take ownership of the
+     * job.
+     * 
+     * @param job The job to queue.
+     */
+    void add(Job* const job);
+    
+    /**
+     * Executes all queued jobs, and returns when they are done. The queue is
+     * empty afterwards.
+     */
+    void run();
+    
+    /**
+     * Gets the amount of threads jobs are executed on, including the thread
+     * calling run().
+     * 
+     * @return The amount of threads.
+     */
+    unsigned int getThreadCount() const;
+    
+    /**
+     * Gets the amount of processors available on this machine.
+     * 
+     * @return The amount of processors, at least 1.
+     */
+    static unsigned int getProcessorCount();
+};
+
+} // namespace ogle
+
+
+#endif // JOBS_HPP
@@ -20,7 +20,11 @@
 #include "ogle.hpp"
 #include "core.hpp"
 #include "collision.hpp"
+#include "pacer.hpp"
+#include "render.hpp"
 
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 
 
@@ -57,7 +61,32 @@ void glInit() {
     gluPerspective(45.0f, static_cast<GLfloat>(ogle::SCREEN_WIDTH) / static_cast<GLfloat>(ogle::SCREEN_HEIGHT), 1.0f, 500.0f);   
 }
 
+/**
+ * Reads the frame pacing options from the command line: --vsync, --uncapped,
+ * or --fps followed by the target rate.
+ */
+void parsePacing(int argc, char* argv[], ogle::FramePacer& pacer) {
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "--vsync") == 0) {
+            pacer.setMode(ogle::PACING_VSYNC);
+        } else if(strcmp(argv[i], "--uncapped") == 0) {
+            pacer.setMode(ogle::PACING_UNCAPPED);
+        } else if(strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+            const float rate = static_cast<float>(atof(argv[++i]));
+            if(rate > 0.0f) {
+                pacer.setMode(ogle::PACING_LIMIT);
+                pacer.setTargetRate(rate);
+            }
+        } else {
+            std::cerr << "Ignoring unknown option: " << argv[i] << std::endl;
+        }
+    }
+}
+
 int main(int argc, char* argv[]) {
+    ogle::FramePacer pacer;
+    parsePacing(argc, argv, pacer);
+    
     sf::WindowSettings settings;
     settings.DepthBits         = 24; // Request a 24 bits depth buffer
     settings.StencilBits       = 8;  // Request a 8 bits stencil buffer
@@ -70,6 +99,7 @@ int main(int argc, char* argv[]) {
     sf::Clock Clock;
 
     glInit();
+    pacer.apply(App);
 
     GLfloat xrot = 0.0f;
     GLfloat yrot = 0.0f;
@@ -84,6 +114,8 @@ int main(int argc, char* argv[]) {
     
     ogle::Box box3;
     box3.setPosition(2.0f, 1.0f, -1.0f);
+    
+    ogle::RenderQueue queue;
 
     // Start game loop
     while (App.IsOpened()) {
@@ -123,6 +155,11 @@ int main(int argc, char* argv[]) {
                         break;
                     case sf::Key::Tab:
                         break;
+                    case sf::Key::V:
+                        // cycle through vsync, limited and uncapped.
+                        pacer.setMode(static_cast<ogle::PacingMode>((pacer.getMode() + 1) % 3));
+                        pacer.apply(App);
+                        break;
                     default:
                         break;
                 }
@@ -144,15 +181,28 @@ int main(int argc, char* argv[]) {
         glTranslatef(-4, -3.5, -10.0f);
         glRotatef(xrot, 0.0f, 1.0f, 0.0f);
         glRotatef(yrot, 1.0f, 0.0f, 0.0f);
-        axis.render();
-        box.render();
-        box2.render();
-        box3.render();
+        queue.begin();
+        queue.add(&axis);
+        queue.add(&box);
+        queue.add(&box2);
+        queue.add(&box3);
+        queue.flush();
         
         // finally, display rendered frame on screen
         App.Display();
-                
-        sf::Sleep(0.01f);
+        
+        pacer.endFrame();
+        
+        // report the frame time every second.
+        if (Clock.GetElapsedTime() >= 1.0f) {
+            Clock.Reset();
+            std::cout << "Frame time: " << pacer.getAverageFrameTime() * 1000.0f << " ms ("
+                      << pacer.getBusyTime() * 1000.0f << " ms busy), "
+                      << 1.0f / pacer.getAverageFrameTime() << " fps, "
+                      << queue.getStateChanges() << " state changes ("
+                      << queue.getStateChangesSaved() << " saved), "
+                      << queue.getCulledCount() << " culled" << std::endl;
+        }
     }
 
     return EXIT_SUCCESS;
@@ -0,0 +1,107 @@
+//      pacer.cpp
+//      
+//      Copyright 2010 Kevin Pors <krpors@users.sf.net>
+//      
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//      
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//      
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//      MA 02110-1301, USA.
+
+#include "pacer.hpp"
+
+#include <algorithm>
+
+namespace ogle {
+
+/// Time before the deadline at which to stop sleeping and spin instead, since
+/// sleeps may take a millisecond or more longer than asked for.
+static const float SPIN_TIME = 0.002f;
+
+/// Weight of the last frame in the average frame time.
+static const float AVERAGE_WEIGHT = 0.05f;
+
+FramePacer::FramePacer(const PacingMode& mode, const float& targetRate) :
+        m_mode(mode),
+        m_targetRate(targetRate),
+        m_lag(0.0),
+        m_frameTime(0.0f),
+        m_busyTime(0.0f),
+        m_averageTime(0.0f) {
+}
+
+FramePacer::~FramePacer() {
+}
+
+void FramePacer::setMode(const PacingMode& mode) {
+    m_mode = mode;
+}
+
+const PacingMode& FramePacer::getMode() const {
+    return m_mode;
+}
+
+void FramePacer::setTargetRate(const float& targetRate) {
+    m_targetRate = targetRate;
+}
+
+const float& FramePacer::getTargetRate() const {
+    return m_targetRate;
+}
+
+void FramePacer::apply(sf::Window& window) {
+    window.UseVerticalSync(m_mode == PACING_VSYNC);
+}
+
+void FramePacer::endFrame() {
+    float now = m_clock.GetElapsedTime();
+    m_busyTime = now;
+    
+    if(m_mode == PACING_LIMIT && m_targetRate > 0.0f) {
+        // aim for a fixed schedule, so the time slept too long in one frame is
+        // made up for in the next. When too far behind, start over from now.
+        // The deadline is relative to the start of this frame.
+        const double budget = 1.0 / m_targetRate;
+        const double deadline = std::max(budget - m_lag, now - budget);
+        if(deadline - now > SPIN_TIME) {
+            sf::Sleep(static_cast<float>(deadline - now - SPIN_TIME));
+        }
+        while((now = m_clock.GetElapsedTime()) < deadline) {
+        }
+        m_lag = now - deadline;
+    } else {
+        m_lag = 0.0;
+    }
+    
+    // the next frame starts now.
+    m_clock.Reset();
+    m_frameTime = now;
+    if(m_averageTime == 0.0f) {
+        m_averageTime = m_frameTime;
+    } else {
+        m_averageTime += (m_frameTime - m_averageTime) * AVERAGE_WEIGHT;
+    }
+}
+
+const float& FramePacer::getFrameTime() const {
+    return m_frameTime;
+}
+
+const float& FramePacer::getBusyTime() const {
+    return m_busyTime;
+}
+
+const float& FramePacer::getAverageFrameTime() const {
+    return m_averageTime;
+}
+
+} // namespace ogle
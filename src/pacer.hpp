@@ -0,0 +1,144 @@
+//      pacer.hpp
+//      
+//      Copyright 2010 Kevin Pors <krpors@users.sf.net>
+//      
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//      
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//      
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//      MA 02110-1301, USA.
+
+#ifndef PACER_HPP
+#define PACER_HPP
+
+#include <SFML/Window.hpp>
+
+namespace ogle {
+
+/// How a FramePacer paces the frames.
+enum PacingMode {
+    /// Wait for the vertical sync of the display in Display().
+    PACING_VSYNC,
+    
+    /// Sleep for what is left of the frame budget of the target rate.
+    PACING_LIMIT,
+    
+    /// Render frames as fast as possible.
+    PACING_UNCAPPED
+};
+
+/**
+ * Paces the frames of the main loop, and measures how long they take. Call 
+ * apply() once after creating the window, and endFrame() after every call to
+ * Display().
+ * 
+ * Unlike sleeping a fixed amount every frame, the limiter only sleeps for the
+ * part of the frame budget that is left, so cheap frames don't add latency 
+ * and expensive frames don't drop below the target rate because of sleeping.
+ */
+class FramePacer {
+private:
+    /// The way to pace.
+    PacingMode m_mode;
+    
+    /// The amount of frames per second to aim for when limiting.
+    float m_targetRate;
+    
+    /// Time since the start of the current frame. Reset every frame, so the
+    /// times stay small enough to be precise as a float, however long the 
+    /// program runs.
+    sf::Clock m_clock;
+    
+    /// How far the last frame ended after its deadline when limiting, or 
+    /// before it when negative.
+    double m_lag;
+    
+    /// Duration of the last frame, including waiting.
+    float m_frameTime;
+    
+    /// Time the last frame took before waiting.
+    float m_busyTime;
+    
+    /// Smoothed frame time.
+    float m_averageTime;
+    
+public:
+    /**
+     * Creates the pacer.
+     * 
+     * @param mode The way to pace.
+     * @param targetRate The frames per second to aim for with PACING_LIMIT.
+     */
+    FramePacer(const PacingMode& mode = PACING_LIMIT, const float& targetRate = 60.0f);
+    
+    ~FramePacer();
+    
+    /**
+     * Sets the way to pace. Call apply() afterwards to update the window.
+     * 
+     * @param mode The mode.
+     */
+    void setMode(const PacingMode& mode);
+    
+    const PacingMode& getMode() const;
+    
+    /**
+     * Sets the frames per second to aim for with PACING_LIMIT.
+     * 
+     * @param targetRate The rate, larger than 0.
+     */
+    void setTargetRate(const float& targetRate);
+    
+    const float& getTargetRate() const;
+    
+    /**
+     * Applies the mode to the window, by turning its vertical sync on or off.
+     * 
+     * @param window The window.
+     */
+    void apply(sf::Window& window);
+    
+    /**
+     * Ends the current frame: waits for what is left of the frame budget when
+     * limiting, and measures the frame time. The next frame starts when this
+     * returns.
+     */
+    void endFrame();
+    
+    /**
+     * Gets the duration of the last frame, including waiting.
+     * 
+     * @return The frame time in seconds.
+     */
+    const float& getFrameTime() const;
+    
+    /**
+     * Gets the time the last frame took before waiting, i.e. the time spent on
+     * input, simulation and rendering.
+     * 
+     * @return The busy time in seconds.
+     */
+    const float& getBusyTime() const;
+    
+    /**
+     * Gets the frame time, smoothed over the last frames, which is better to 
+     * report than the frame time of a single frame.
+     * 
+     * @return The average frame time in seconds.
+     */
+    const float& getAverageFrameTime() const;
+};
+
+} // namespace ogle
+
+
+#endif // PACER_HPP
@@ -0,0 +1,115 @@
+//      random.cpp
+//      
+//      Copyright 2010 Kevin Pors <krpors@users.sf.net>
+//      
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//      
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//      
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//      MA 02110-1301, USA.
+
+#include "random.hpp"
+
+namespace ogle {
+
+/// Scale from the upper 24 bits of a number to [0, 1).
+static const GLfloat UNIT = 1.0f / 16777216.0f;
+
+/**
+ * Scrambles a number (MurmurHash3 finalizer). Numbers close to each other give
+ * very different results, and only 0 maps to 0.
+ */
+static GLuint scramble(GLuint s) {
+    s ^= s >> 16;
+    s *= 0x85ebca6bU;
+    s ^= s >> 13;
+    s *= 0xc2b2ae35U;
+    s ^= s >> 16;
+    return s;
+}
+
+Random::Random(const GLuint& seed) {
+    setSeed(seed);
+}
+
+Random::~Random() {
+}
+
+void Random::setSeed(const GLuint& seed) {
+    // derive every word of state from the seed. A generator must not have an
+    // all zero state, or it will only ever produce zeroes.
+    for(GLuint lane = 0; lane < LANES; lane++) {
+        for(GLuint word = 0; word < 4; word++) {
+            m_state[word][lane] = scramble(seed + (lane * 4 + word + 1) * 0x9e3779b9U);
+        }
+        if((m_state[0][lane] | m_state[1][lane] | m_state[2][lane] | m_state[3][lane]) == 0) {
+            m_state[0][lane] = 0x9e3779b9U;
+        }
+    }
+    m_used = LANES;
+}
+
+inline void Random::advance(GLuint* out) {
+    GLuint* s0 = m_state[0];
+    GLuint* s1 = m_state[1];
+    GLuint* s2 = m_state[2];
+    GLuint* s3 = m_state[3];
+    // xoshiro128+ by David Blackman and Sebastiano Vigna, once per lane.
+    for(GLuint lane = 0; lane < LANES; lane++) {
+        out[lane] = s0[lane] + s3[lane];
+        const GLuint t = s1[lane] << 9;
+        s2[lane] ^= s0[lane];
+        s3[lane] ^= s1[lane];
+        s1[lane] ^= s2[lane];
+        s0[lane] ^= s3[lane];
+        s2[lane] ^= t;
+        s3[lane] = (s3[lane] << 11) | (s3[lane] >> 21);
+    }
+}
+
+GLuint Random::next() {
+    if(m_used == LANES) {
+        advance(m_buffer);
+        m_used = 0;
+    }
+    return m_buffer[m_used++];
+}
+
+GLfloat Random::nextFloat(const GLfloat& min, const GLfloat& max) {
+    // the upper bits of xoshiro128+ are the best ones; 24 fit a float exactly.
+    return min + (max - min) * ((next() >> 8) * UNIT);
+}
+
+void Random::fill(GLfloat* const out, const GLuint& count, const GLfloat& min, const GLfloat& max) {
+    const GLfloat range = max - min;
+    GLuint i = 0;
+    
+    // first hand out what's left from a previous next().
+    for(; i < count && m_used < LANES; i++) {
+        out[i] = nextFloat(min, max);
+    }
+    
+    // then advance all generators at once, straight into the output.
+    GLuint bits[LANES];
+    for(; i + LANES <= count; i += LANES) {
+        advance(bits);
+        for(GLuint lane = 0; lane < LANES; lane++) {
+            out[i + lane] = min + range * ((bits[lane] >> 8) * UNIT);
+        }
+    }
+    
+    for(; i < count; i++) {
+        out[i] = nextFloat(min, max);
+    }
+}
+
+} // namespace ogle
@@ -0,0 +1,109 @@
+//      random.hpp
+//      
+//      Copyright 2010 Kevin Pors <krpors@users.sf.net>
+//      
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//      
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//      
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//      MA 02110-1301, USA.
+
+#ifndef RANDOM_HPP
+#define RANDOM_HPP
+
+#include <GL/gl.h>
+
+namespace ogle {
+
+/**
+ * Fast, seedable pseudo random number generator. Unlike sf::Randomizer, every
+ * instance has its own state, so separate instances can be used from separate
+ * threads, and a sequence can be reproduced by seeding.
+ * 
+ * Internally it runs four xoshiro128+ generators side by side, which are 
+ * advanced together; the sequence is formed by taking their outputs in turn.
+ * Advancing four independent states at once is cheap to vectorize, which is
+ * what fill() does for generating many numbers at once. next() and fill() 
+ * take from the same sequence.
+ */
+class Random {
+private:
+    /// Amount of generators running side by side.
+    static const GLuint LANES = 4;
+    
+    /// State of the generators, as m_state[word][lane].
+    GLuint m_state[4][LANES];
+    
+    /// Last outputs of the generators, handed out by next().
+    GLuint m_buffer[LANES];
+    
+    /// Amount of numbers in m_buffer which have been handed out already.
+    GLuint m_used;
+    
+    /**
+     * Advances all generators one step, and stores their outputs.
+     * 
+     * @param out Array of LANES numbers to store the outputs in.
+     */
+    inline void advance(GLuint* out);
+
+public:
+    /**
+     * Creates a random number generator.
+     * 
+     * @param seed The seed.
+     */
+    Random(const GLuint& seed = 0);
+    
+    ~Random();
+    
+    /**
+     * Restarts the sequence of numbers using the given seed. The same seed
+     * gives the same sequence.
+     * 
+     * @param seed The seed.
+     */
+    void setSeed(const GLuint& seed);
+    
+    /**
+     * Gets the next number in the sequence.
+     * 
+     * @return A number in the range [0, 2^32 - 1].
+     */
+    GLuint next();
+    
+    /**
+     * Gets a random float in the given range.
+     * 
+     * @param min The minimum value.
+     * @param max The maximum value.
+     * @return A float in the range [min, max).
+     */
+    GLfloat nextFloat(const GLfloat& min, const GLfloat& max);
+    
+    /**
+     * Fills an array with random floats in the given range. This gives the 
+     * same numbers as calling nextFloat() count times, but is a lot faster 
+     * for bigger arrays.
+     * 
+     * @param out The array to fill.
+     * @param count The amount of floats to generate.
+     * @param min The minimum value.
+     * @param max The maximum value.
+     */
+    void fill(GLfloat* const out, const GLuint& count, const GLfloat& min, const GLfloat& max);
+};
+
+} // namespace ogle
+
+
+#endif // RANDOM_HPP
@@ -0,0 +1,214 @@
+//      render.cpp
+//      
+//      Copyright 2010 Kevin Pors <krpors@users.sf.net>
+//      
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//      
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//      
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//      MA 02110-1301, USA.
+
+#include "render.hpp"
+
+#include <algorithm>
+
+namespace ogle {
+
+/// Bits of the sort key holding the id of a state.
+static const GLuint STATE_ID_MASK = 0x1fffffff;
+
+/**
+ * Orders render items: by pass first, then opaque items by state and front to
+ * back, and transparent items back to front and by state.
+ */
+struct RenderOrder {
+    template <class T>
+    bool operator()(const T& a, const T& b) const {
+        const GLuint passA = a.key >> 31;
+        const GLuint passB = b.key >> 31;
+        if(passA != passB) {
+            return passA < passB;
+        }
+        if(passA == PASS_TRANSPARENT && a.depth != b.depth) {
+            return a.depth > b.depth;
+        }
+        if(a.key != b.key) {
+            return a.key < b.key;
+        }
+        return a.depth < b.depth;
+    }
+};
+
+/**
+ * Gets the amount of state changes needed to set a state from scratch.
+ */
+static GLuint countState(const RenderState& state) {
+    // lighting, blending and front face, plus the optional blend function and
+    // material.
+    return 3 + (state.blending ? 1 : 0) + (state.material ? 1 : 0);
+}
+
+RenderQueue::RenderQueue() :
+        m_culling(true),
+        m_culled(0),
+        m_stateChanges(0),
+        m_stateChangesSaved(0) {
+    for(GLuint i = 0; i < 16; i++) {
+        m_modelview[i] = (i % 5 == 0) ? 1.0f : 0.0f;
+    }
+}
+
+RenderQueue::~RenderQueue() {
+}
+
+void RenderQueue::begin() {
+    m_items.clear();
+    m_states.clear();
+    m_stateIds.clear();
+    m_culled = 0;
+    
+    GLfloat projection[16];
+    glGetFloatv(GL_PROJECTION_MATRIX, projection);
+    glGetFloatv(GL_MODELVIEW_MATRIX, m_modelview);
+    m_frustum.extract(projection, m_modelview);
+}
+
+void RenderQueue::add(Object* const object) {
+    const AABB3& box = object->getBoundary3D();
+    if(m_culling && !m_frustum.intersects(box)) {
+        m_culled++;
+        return;
+    }
+    
+    const RenderState& state = object->getRenderState();
+    
+    // equal states share an id, so they end up next to each other. A new
+    // state gets the next id.
+    std::pair<std::map<RenderState, GLuint>::iterator, bool> found = 
+            m_stateIds.insert(std::make_pair(state, static_cast<GLuint>(m_states.size())));
+    if(found.second) {
+        m_states.push_back(state);
+    }
+    const GLuint id = found.first->second;
+    
+    // the depth is -z of the center in eye space, the camera looks along -z.
+    const GLfloat cx = box.x + box.w / 2.0f;
+    const GLfloat cy = box.y + box.h / 2.0f;
+    const GLfloat cz = box.z + box.d / 2.0f;
+    
+    RenderItem item;
+    item.object = object;
+    item.key = (static_cast<GLuint>(state.pass) << 31) |
+               ((state.lighting ? 1u : 0u) << 30) |
+               ((state.blending ? 1u : 0u) << 29) |
+               (id & STATE_ID_MASK);
+    item.depth = -(m_modelview[2] * cx + m_modelview[6] * cy + m_modelview[10] * cz + m_modelview[14]);
+    m_items.push_back(item);
+}
+
+GLuint RenderQueue::applyState(const RenderState& state, const RenderState* current) {
+    GLuint changes = 0;
+    if(current == NULL || state.lighting != current->lighting) {
+        if(state.lighting) {
+            glEnable(GL_LIGHTING);
+        } else {
+            glDisable(GL_LIGHTING);
+        }
+        changes++;
+    }
+    if(current == NULL || state.blending != current->blending) {
+        if(state.blending) {
+            glEnable(GL_BLEND);
+        } else {
+            glDisable(GL_BLEND);
+        }
+        changes++;
+    }
+    if(state.blending && (current == NULL || !current->blending || 
+       state.srcBlend != current->srcBlend || state.dstBlend != current->dstBlend)) {
+        glBlendFunc(state.srcBlend, state.dstBlend);
+        changes++;
+    }
+    if(state.material) {
+        const Color& c = state.color;
+        if(current == NULL || !current->material || c.getR() != current->color.getR() ||
+           c.getG() != current->color.getG() || c.getB() != current->color.getB() ||
+           c.getA() != current->color.getA()) {
+            const GLfloat color[] = { c.getR(), c.getG(), c.getB(), c.getA() };
+            glMaterialfv(GL_FRONT, GL_AMBIENT_AND_DIFFUSE, color);
+            changes++;
+        }
+    }
+    if(current == NULL || state.frontFace != current->frontFace) {
+        glFrontFace(state.frontFace);
+        changes++;
+    }
+    return changes;
+}
+
+void RenderQueue::flush() {
+    m_stateChanges = 0;
+    m_stateChangesSaved = 0;
+    if(m_items.empty()) {
+        return;
+    }
+    
+    // stable, so objects with the same key and depth keep the order of add().
+    std::stable_sort(m_items.begin(), m_items.end(), RenderOrder());
+    
+    GLuint naive = 0;
+    const RenderState* current = NULL;
+    std::vector<RenderItem>::iterator it;
+    for(it = m_items.begin(); it != m_items.end(); it++) {
+        const RenderState& state = m_states[it->key & STATE_ID_MASK];
+        m_stateChanges += applyState(state, current);
+        naive += countState(state);
+        it->object->draw();
+        current = &state;
+    }
+    
+    // back to the default state, for whatever is rendered next.
+    const RenderState defaults;
+    m_stateChanges += applyState(defaults, current);
+    naive += countState(defaults);
+    m_stateChangesSaved = naive > m_stateChanges ? naive - m_stateChanges : 0;
+    
+    m_items.clear();
+    m_states.clear();
+    m_stateIds.clear();
+}
+
+void RenderQueue::setCulling(bool culling) {
+    m_culling = culling;
+}
+
+bool RenderQueue::isCulling() const {
+    return m_culling;
+}
+
+GLuint RenderQueue::getCulledCount() const {
+    return m_culled;
+}
+
+GLuint RenderQueue::getSize() const {
+    return m_items.size();
+}
+
+GLuint RenderQueue::getStateChanges() const {
+    return m_stateChanges;
+}
+
+GLuint RenderQueue::getStateChangesSaved() const {
+    return m_stateChangesSaved;
+}
+
+} // namespace ogle
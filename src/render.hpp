@@ -0,0 +1,167 @@
+//      render.hpp
+//      
+//      Copyright 2010 Kevin Pors <krpors@users.sf.net>
+//      
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//      
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//      
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//      MA 02110-1301, USA.
+
+#ifndef RENDER_HPP
+#define RENDER_HPP
+
+#include "core.hpp"
+#include "frustum.hpp"
+
+#include <GL/gl.h>
+#include <map>
+#include <vector>
+
+namespace ogle {
+
+/**
+ * Collects the objects to render in a frame, and renders them sorted by their
+ * RenderState, so OpenGL state is only changed between objects which need
+ * different state. Opaque objects go first, grouped by state and front to 
+ * back within a group. Transparent objects go last, back to front, so they 
+ * blend correctly.
+ * 
+ * Objects outside the view frustum are culled when they are added, by their
+ * getBoundary3D(), so they cost nothing to render. For a ParticleGenerator,
+ * that is the box around all of its particles.
+ * 
+ * Usage: begin() after setting up the camera, add() the objects, and flush().
+ * All objects are drawn with the modelview matrix as it was at begin(). The
+ * queue does not own the objects, which must stay alive until flush().
+ */
+class RenderQueue {
+private:
+    /// A single object to render.
+    struct RenderItem {
+        /// The object.
+        Object* object;
+        
+        /// Sort key: the pass, lighting, blending and an id per distinct state.
+        GLuint key;
+        
+        /// Distance from the camera to the center of the object.
+        GLfloat depth;
+    };
+    
+    /// The objects added since begin().
+    std::vector<RenderItem> m_items;
+    
+    /// The distinct states of the objects added since begin(), by id.
+    std::vector<RenderState> m_states;
+    
+    /// The ids of the states in m_states, to find the id of a state quickly.
+    std::map<RenderState, GLuint> m_stateIds;
+    
+    /// The modelview matrix at begin(), for the depths.
+    GLfloat m_modelview[16];
+    
+    /// The view frustum at begin().
+    Frustum m_frustum;
+    
+    /// Whether objects outside the frustum are culled.
+    bool m_culling;
+    
+    /// Objects culled since begin().
+    GLuint m_culled;
+    
+    /// State changes made by the last flush().
+    GLuint m_stateChanges;
+    
+    /// State changes avoided by the last flush().
+    GLuint m_stateChangesSaved;
+    
+    /**
+     * Sets the state, changing only what differs from the current state.
+     * 
+     * @param state The state to set.
+     * @param current The state currently set, or NULL if unknown.
+     * @return The amount of state changes made.
+     */
+    static GLuint applyState(const RenderState& state, const RenderState* current);
+    
+public:
+    RenderQueue();
+    
+    ~RenderQueue();
+    
+    /**
+     * Starts a new frame: drops all objects still queued, and takes the 
+     * current projection and modelview matrices as the camera.
+     */
+    void begin();
+    
+    /**
+     * Queues an object for rendering, unless it's culled.
+     * 
+     * @param object The object.
+     */
+    void add(Object* const object);
+    
+    /**
+     * Renders all queued objects in sorted order, and empties the queue. 
+     * Afterwards, the state is that of a default RenderState, unless the 
+     * queue was empty.
+     */
+    void flush();
+    
+    /**
+     * Sets whether objects outside the view frustum are culled. The default 
+     * is true.
+     * 
+     * @param culling true to cull.
+     */
+    void setCulling(bool culling);
+    
+    bool isCulling() const;
+    
+    /**
+     * Gets the amount of objects culled since begin(). Unlike the queued 
+     * objects, this is kept after flush().
+     * 
+     * @return The amount of culled objects.
+     */
+    GLuint getCulledCount() const;
+    
+    /**
+     * Gets the amount of queued objects.
+     * 
+     * @return The amount of objects.
+     */
+    GLuint getSize() const;
+    
+    /**
+     * Gets the amount of state changes made by the last flush(), including
+     * the ones to restore the default state.
+     * 
+     * @return The amount of state changes.
+     */
+    GLuint getStateChanges() const;
+    
+    /**
+     * Gets the amount of state changes the last flush() did not need to make,
+     * compared to setting the complete state for every object, like render()
+     * does.
+     * 
+     * @return The amount of state changes saved.
+     */
+    GLuint getStateChangesSaved() const;
+};
+
+} // namespace ogle
+
+#endif // RENDER_HPP
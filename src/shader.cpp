@@ -0,0 +1,136 @@
+//      shader.cpp
+//      
+//      Copyright 2010 Kevin Pors <krpors@users.sf.net>
+//      
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//      
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//      
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//      MA 02110-1301, USA.
+
+#include "shader.hpp"
+
+#include <iostream>
+
+namespace ogle {
+
+ShaderProgram::ShaderProgram(const std::string& vertexSource, const std::string& fragmentSource) :
+        m_id(0),
+        m_failed(false),
+        m_vertexSource(vertexSource),
+        m_fragmentSource(fragmentSource) {
+}
+
+ShaderProgram::~ShaderProgram() {
+    if(m_id != 0) {
+        GLExtensions::deleteProgram(m_id);
+    }
+}
+
+void ShaderProgram::bindAttribute(const GLuint& index, const std::string& name) {
+    if(m_attributes.size() <= index) {
+        m_attributes.resize(index + 1);
+    }
+    m_attributes[index] = name;
+}
+
+GLuint ShaderProgram::compile(const GLenum& type, const std::string& source) {
+    GLuint shader = GLExtensions::createShader(type);
+    const GLchar* text = source.c_str();
+    GLExtensions::shaderSource(shader, 1, &text, NULL);
+    GLExtensions::compileShader(shader);
+    
+    GLint status = GL_FALSE;
+    GLExtensions::getShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if(status != GL_TRUE) {
+        GLchar log[1024];
+        GLExtensions::getShaderInfoLog(shader, sizeof(log), NULL, log);
+        std::cerr << "Compiling shader failed: " << log << std::endl;
+        GLExtensions::deleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+bool ShaderProgram::build() {
+    GLExtensions::load();
+    if(!GLExtensions::hasShaders()) {
+        return false;
+    }
+    
+    GLuint vertex   = compile(GL_VERTEX_SHADER, m_vertexSource);
+    GLuint fragment = compile(GL_FRAGMENT_SHADER, m_fragmentSource);
+    if(vertex == 0 || fragment == 0) {
+        if(vertex != 0) {
+            GLExtensions::deleteShader(vertex);
+        }
+        if(fragment != 0) {
+            GLExtensions::deleteShader(fragment);
+        }
+        return false;
+    }
+    
+    m_id = GLExtensions::createProgram();
+    GLExtensions::attachShader(m_id, vertex);
+    GLExtensions::attachShader(m_id, fragment);
+    for(GLuint i = 0; i < m_attributes.size(); i++) {
+        if(!m_attributes[i].empty()) {
+            GLExtensions::bindAttribLocation(m_id, i, m_attributes[i].c_str());
+        }
+    }
+    GLExtensions::linkProgram(m_id);
+    
+    // the program keeps the shaders alive as long as they're attached.
+    GLExtensions::deleteShader(vertex);
+    GLExtensions::deleteShader(fragment);
+    
+    GLint status = GL_FALSE;
+    GLExtensions::getProgramiv(m_id, GL_LINK_STATUS, &status);
+    if(status != GL_TRUE) {
+        GLchar log[1024];
+        GLExtensions::getProgramInfoLog(m_id, sizeof(log), NULL, log);
+        std::cerr << "Linking shader program failed: " << log << std::endl;
+        GLExtensions::deleteProgram(m_id);
+        m_id = 0;
+        return false;
+    }
+    return true;
+}
+
+bool ShaderProgram::use() {
+    if(m_id == 0) {
+        if(m_failed) {
+            return false;
+        }
+        if(!build()) {
+            m_failed = true;
+            return false;
+        }
+    }
+    GLExtensions::useProgram(m_id);
+    return true;
+}
+
+GLint ShaderProgram::getUniform(const std::string& name) const {
+    if(m_id == 0) {
+        return -1;
+    }
+    return GLExtensions::getUniformLocation(m_id, name.c_str());
+}
+
+void ShaderProgram::release() {
+    if(GLExtensions::hasShaders()) {
+        GLExtensions::useProgram(0);
+    }
+}
+
+} // namespace ogle
@@ -0,0 +1,117 @@
+//      shader.hpp
+//      
+//      Copyright 2010 Kevin Pors <krpors@users.sf.net>
+//      
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//      
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//      
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//      MA 02110-1301, USA.
+
+#ifndef SHADER_HPP
+#define SHADER_HPP
+
+#include "glext.hpp"
+
+#include <GL/gl.h>
+#include <string>
+#include <vector>
+
+namespace ogle {
+
+/**
+ * A GLSL program, built from a vertex and a fragment shader. The program is 
+ * compiled and linked the first time it's used, so it can be created before an
+ * OpenGL context exists. When building fails, the log is written to std::cerr
+ * and use() keeps returning false.
+ */
+class ShaderProgram {
+private:
+    /// The program object, or 0 when not built (yet).
+    GLuint m_id;
+    
+    /// Whether building has been tried and failed.
+    bool m_failed;
+    
+    /// Source of the vertex shader.
+    std::string m_vertexSource;
+    
+    /// Source of the fragment shader.
+    std::string m_fragmentSource;
+    
+    /// Names of the vertex attributes, by their index.
+    std::vector<std::string> m_attributes;
+    
+    /**
+     * Compiles a single shader.
+     * 
+     * @param type GL_VERTEX_SHADER or GL_FRAGMENT_SHADER.
+     * @param source The source code.
+     * @return The shader object, or 0 when compiling failed.
+     */
+    GLuint compile(const GLenum& type, const std::string& source);
+    
+    /**
+     * Compiles and links the program.
+     * 
+     * @return true when successful.
+     */
+    bool build();
+
+public:
+    /**
+     * Creates a shader program. No OpenGL calls are made until use().
+     * 
+     * @param vertexSource Source of the vertex shader.
+     * @param fragmentSource Source of the fragment shader.
+     */
+    ShaderProgram(const std::string& vertexSource, const std::string& fragmentSource);
+    
+    /**
+     * Destroys the program object, if any.
+     */
+    ~ShaderProgram();
+    
+    /**
+     * Binds a vertex attribute of the vertex shader to a fixed index. Must be
+     * called before the first use().
+     * 
+     * @param index The index of the attribute.
+     * @param name The name of the attribute in the vertex shader.
+     */
+    void bindAttribute(const GLuint& index, const std::string& name);
+    
+    /**
+     * Makes this the current program, building it first if needed.
+     * 
+     * @return true when the program is usable and in use, false otherwise.
+     */
+    bool use();
+    
+    /**
+     * Gets the location of a uniform variable. The program must be built.
+     * 
+     * @param name The name of the uniform.
+     * @return The location, or -1 when there's no such uniform.
+     */
+    GLint getUniform(const std::string& name) const;
+    
+    /**
+     * Switches back to the fixed function pipeline.
+     */
+    static void release();
+};
+
+} // namespace ogle
+
+
+#endif // SHADER_HPP
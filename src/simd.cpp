@@ -0,0 +1,397 @@
+//      simd.cpp
+//      
+//      Copyright 2010 Kevin Pors <krpors@users.sf.net>
+//      
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//      
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//      
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//      MA 02110-1301, USA.
+
+#include "simd.hpp"
+
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define OGLE_SIMD_X86
+#include <immintrin.h>
+#endif
+
+namespace ogle {
+
+/// Pointers into a particle storage, offset to the first particle of a range.
+struct IntegrateArrays {
+    GLfloat* x;
+    GLfloat* y;
+    GLfloat* z;
+    const GLfloat* xv;
+    GLfloat* yv;
+    const GLfloat* zv;
+    GLfloat* life;
+    const GLfloat* gravity;
+    const GLfloat* fade;
+    const GLubyte* active;
+};
+
+static void integrateScalar(const IntegrateArrays& p, GLuint i, const GLuint& n) {
+    for(; i < n; i++) {
+        if(p.life[i] > 0.0f && p.active[i]) {
+            p.x[i] += p.xv[i];
+            p.y[i] += p.yv[i];
+            p.z[i] += p.zv[i];
+            
+            p.yv[i] += p.gravity[i];
+            
+            // same as Particle::setLife(), do not go below zero.
+            p.life[i] = std::max(0.0f, p.life[i] + p.fade[i]);
+        }
+    }
+}
+
+/// Pointers into a particle storage for bounceParticles(), offset like IntegrateArrays.
+struct BounceArrays {
+    const GLfloat* x;
+    GLfloat* y;
+    const GLfloat* z;
+    GLfloat* px;
+    GLfloat* py;
+    GLfloat* pz;
+    GLfloat* xv;
+    GLfloat* yv;
+    GLfloat* gravity;
+    const GLubyte* eligible;
+    GLubyte* out;
+};
+
+/// Change of gravity when bouncing off the sides, see CollisionBehavior::boundsCollided().
+static const GLfloat BOUNCE_GRAVITY = 0.005f;
+
+static GLuint bounceScalar(const BounceArrays& p, GLuint i, const GLuint& n, const Rect& bounds) {
+    GLuint count = 0;
+    for(; i < n; i++) {
+        const GLfloat x = p.x[i];
+        const GLfloat y = p.y[i];
+        const bool side = x <= bounds.x || x >= bounds.w;
+        const bool hit = p.eligible[i] && (side || y <= bounds.y || y >= bounds.h);
+        p.out[i] = hit ? 1 : 0;
+        if(!hit) {
+            continue;
+        }
+        count++;
+        if(side) {
+            p.xv[i] = -p.xv[i];
+            p.gravity[i] -= BOUNCE_GRAVITY;
+        } else if(y <= bounds.y) {
+            if(y != 0.0f) {
+                p.px[i] = x;
+                p.py[i] = 0.0f;
+                p.pz[i] = p.z[i];
+            }
+            p.y[i]  = 0.0f;
+            p.yv[i] = 0.0f;
+            p.xv[i] = 0.0f;
+        } else {
+            p.yv[i] = 0.0f;
+            p.xv[i] = 0.0f;
+        }
+    }
+    return count;
+}
+
+#ifdef OGLE_SIMD_X86
+
+/// Selects a where the mask is set, and b where it's not.
+__attribute__((target("sse2")))
+static inline __m128 select4(const __m128& mask, const __m128& a, const __m128& b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+__attribute__((target("sse2")))
+static void integrateSse2(const IntegrateArrays& p, GLuint i, const GLuint& n) {
+    const __m128  zero  = _mm_setzero_ps();
+    const __m128i izero = _mm_setzero_si128();
+    
+    for(; i + 4 <= n; i += 4) {
+        // widen the four 'active' bytes to 32 bits lanes, and combine them 
+        // with life > 0 to get the mask of particles which are alive.
+        int flags;
+        memcpy(&flags, p.active + i, sizeof(flags));
+        __m128i wide = _mm_unpacklo_epi8(_mm_cvtsi32_si128(flags), izero);
+        wide = _mm_unpacklo_epi16(wide, izero);
+        const __m128 inactive = _mm_castsi128_ps(_mm_cmpeq_epi32(wide, izero));
+        
+        const __m128 life = _mm_loadu_ps(p.life + i);
+        const __m128 alive = _mm_andnot_ps(inactive, _mm_cmpgt_ps(life, zero));
+        
+        const __m128 x  = _mm_loadu_ps(p.x + i);
+        const __m128 y  = _mm_loadu_ps(p.y + i);
+        const __m128 z  = _mm_loadu_ps(p.z + i);
+        const __m128 yv = _mm_loadu_ps(p.yv + i);
+        
+        _mm_storeu_ps(p.x + i,  select4(alive, _mm_add_ps(x, _mm_loadu_ps(p.xv + i)), x));
+        _mm_storeu_ps(p.y + i,  select4(alive, _mm_add_ps(y, yv), y));
+        _mm_storeu_ps(p.z + i,  select4(alive, _mm_add_ps(z, _mm_loadu_ps(p.zv + i)), z));
+        _mm_storeu_ps(p.yv + i, select4(alive, _mm_add_ps(yv, _mm_loadu_ps(p.gravity + i)), yv));
+        
+        // max(v, 0) yields 0 for v <= 0, same as std::max(0.0f, v).
+        const __m128 faded = _mm_max_ps(_mm_add_ps(life, _mm_loadu_ps(p.fade + i)), zero);
+        _mm_storeu_ps(p.life + i, select4(alive, faded, life));
+    }
+    
+    integrateScalar(p, i, n);
+}
+
+/// Selects a where the mask is set, and b where it's not.
+__attribute__((target("avx2")))
+static inline __m256 select8(const __m256& mask, const __m256& a, const __m256& b) {
+    return _mm256_blendv_ps(b, a, mask);
+}
+
+__attribute__((target("avx2")))
+static void integrateAvx2(const IntegrateArrays& p, GLuint i, const GLuint& n) {
+    const __m256  zero  = _mm256_setzero_ps();
+    const __m256i izero = _mm256_setzero_si256();
+    
+    for(; i + 8 <= n; i += 8) {
+        // widen the eight 'active' bytes to 32 bits lanes, and combine them 
+        // with life > 0 to get the mask of particles which are alive.
+        const __m128i flags = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p.active + i));
+        const __m256i wide  = _mm256_cvtepu8_epi32(flags);
+        const __m256 inactive = _mm256_castsi256_ps(_mm256_cmpeq_epi32(wide, izero));
+        
+        const __m256 life = _mm256_loadu_ps(p.life + i);
+        const __m256 alive = _mm256_andnot_ps(inactive, _mm256_cmp_ps(life, zero, _CMP_GT_OQ));
+        
+        const __m256 x  = _mm256_loadu_ps(p.x + i);
+        const __m256 y  = _mm256_loadu_ps(p.y + i);
+        const __m256 z  = _mm256_loadu_ps(p.z + i);
+        const __m256 yv = _mm256_loadu_ps(p.yv + i);
+        
+        _mm256_storeu_ps(p.x + i,  select8(alive, _mm256_add_ps(x, _mm256_loadu_ps(p.xv + i)), x));
+        _mm256_storeu_ps(p.y + i,  select8(alive, _mm256_add_ps(y, yv), y));
+        _mm256_storeu_ps(p.z + i,  select8(alive, _mm256_add_ps(z, _mm256_loadu_ps(p.zv + i)), z));
+        _mm256_storeu_ps(p.yv + i, select8(alive, _mm256_add_ps(yv, _mm256_loadu_ps(p.gravity + i)), yv));
+        
+        // max(v, 0) yields 0 for v <= 0, same as std::max(0.0f, v).
+        const __m256 faded = _mm256_max_ps(_mm256_add_ps(life, _mm256_loadu_ps(p.fade + i)), zero);
+        _mm256_storeu_ps(p.life + i, select8(alive, faded, life));
+    }
+    
+    integrateScalar(p, i, n);
+}
+
+__attribute__((target("sse2")))
+static GLuint bounceSse2(const BounceArrays& p, GLuint i, const GLuint& n, const Rect& bounds) {
+    const __m128  zero    = _mm_setzero_ps();
+    const __m128i izero   = _mm_setzero_si128();
+    const __m128  sign    = _mm_set1_ps(-0.0f);
+    const __m128  left    = _mm_set1_ps(bounds.x);
+    const __m128  right   = _mm_set1_ps(bounds.w);
+    const __m128  bottom  = _mm_set1_ps(bounds.y);
+    const __m128  top     = _mm_set1_ps(bounds.h);
+    const __m128  gravity = _mm_set1_ps(BOUNCE_GRAVITY);
+    
+    GLuint count = 0;
+    for(; i + 4 <= n; i += 4) {
+        int flags;
+        memcpy(&flags, p.eligible + i, sizeof(flags));
+        __m128i wide = _mm_unpacklo_epi8(_mm_cvtsi32_si128(flags), izero);
+        wide = _mm_unpacklo_epi16(wide, izero);
+        const __m128 eligible = _mm_xor_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(wide, izero)), 
+                                           _mm_castsi128_ps(_mm_cmpeq_epi32(izero, izero)));
+        
+        const __m128 x = _mm_loadu_ps(p.x + i);
+        const __m128 y = _mm_loadu_ps(p.y + i);
+        
+        // the masks of the three exclusive cases, like the if/else chain.
+        const __m128 side = _mm_and_ps(eligible, _mm_or_ps(_mm_cmple_ps(x, left), _mm_cmpge_ps(x, right)));
+        const __m128 rest = _mm_andnot_ps(side, eligible);
+        const __m128 low  = _mm_and_ps(rest, _mm_cmple_ps(y, bottom));
+        const __m128 high = _mm_andnot_ps(low, _mm_and_ps(rest, _mm_cmpge_ps(y, top)));
+        const __m128 stop = _mm_or_ps(low, high);
+        
+        const __m128 xv = _mm_loadu_ps(p.xv + i);
+        const __m128 yv = _mm_loadu_ps(p.yv + i);
+        const __m128 g  = _mm_loadu_ps(p.gravity + i);
+        _mm_storeu_ps(p.xv + i, _mm_andnot_ps(stop, select4(side, _mm_xor_ps(xv, sign), xv)));
+        _mm_storeu_ps(p.gravity + i, select4(side, _mm_sub_ps(g, gravity), g));
+        _mm_storeu_ps(p.yv + i, _mm_andnot_ps(stop, yv));
+        _mm_storeu_ps(p.y + i, _mm_andnot_ps(low, y));
+        
+        // reset the previous position of the particles moved to y = 0.
+        const __m128 moved = _mm_andnot_ps(_mm_cmpeq_ps(y, zero), low);
+        const __m128 px = _mm_loadu_ps(p.px + i);
+        const __m128 py = _mm_loadu_ps(p.py + i);
+        const __m128 pz = _mm_loadu_ps(p.pz + i);
+        _mm_storeu_ps(p.px + i, select4(moved, x, px));
+        _mm_storeu_ps(p.py + i, _mm_andnot_ps(moved, py));
+        _mm_storeu_ps(p.pz + i, select4(moved, _mm_loadu_ps(p.z + i), pz));
+        
+        const int hits = _mm_movemask_ps(_mm_or_ps(side, stop));
+        for(GLuint k = 0; k < 4; k++) {
+            p.out[i + k] = (hits >> k) & 1;
+        }
+        count += __builtin_popcount(hits);
+    }
+    
+    return count + bounceScalar(p, i, n, bounds);
+}
+
+__attribute__((target("avx2")))
+static GLuint bounceAvx2(const BounceArrays& p, GLuint i, const GLuint& n, const Rect& bounds) {
+    const __m256  zero    = _mm256_setzero_ps();
+    const __m256i izero   = _mm256_setzero_si256();
+    const __m256  sign    = _mm256_set1_ps(-0.0f);
+    const __m256  left    = _mm256_set1_ps(bounds.x);
+    const __m256  right   = _mm256_set1_ps(bounds.w);
+    const __m256  bottom  = _mm256_set1_ps(bounds.y);
+    const __m256  top     = _mm256_set1_ps(bounds.h);
+    const __m256  gravity = _mm256_set1_ps(BOUNCE_GRAVITY);
+    
+    GLuint count = 0;
+    for(; i + 8 <= n; i += 8) {
+        const __m128i flags = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p.eligible + i));
+        const __m256i wide  = _mm256_cvtepu8_epi32(flags);
+        const __m256 eligible = _mm256_xor_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(wide, izero)), 
+                                              _mm256_castsi256_ps(_mm256_cmpeq_epi32(izero, izero)));
+        
+        const __m256 x = _mm256_loadu_ps(p.x + i);
+        const __m256 y = _mm256_loadu_ps(p.y + i);
+        
+        // the masks of the three exclusive cases, like the if/else chain.
+        const __m256 side = _mm256_and_ps(eligible, _mm256_or_ps(_mm256_cmp_ps(x, left, _CMP_LE_OQ), _mm256_cmp_ps(x, right, _CMP_GE_OQ)));
+        const __m256 rest = _mm256_andnot_ps(side, eligible);
+        const __m256 low  = _mm256_and_ps(rest, _mm256_cmp_ps(y, bottom, _CMP_LE_OQ));
+        const __m256 high = _mm256_andnot_ps(low, _mm256_and_ps(rest, _mm256_cmp_ps(y, top, _CMP_GE_OQ)));
+        const __m256 stop = _mm256_or_ps(low, high);
+        
+        const __m256 xv = _mm256_loadu_ps(p.xv + i);
+        const __m256 yv = _mm256_loadu_ps(p.yv + i);
+        const __m256 g  = _mm256_loadu_ps(p.gravity + i);
+        _mm256_storeu_ps(p.xv + i, _mm256_andnot_ps(stop, select8(side, _mm256_xor_ps(xv, sign), xv)));
+        _mm256_storeu_ps(p.gravity + i, select8(side, _mm256_sub_ps(g, gravity), g));
+        _mm256_storeu_ps(p.yv + i, _mm256_andnot_ps(stop, yv));
+        _mm256_storeu_ps(p.y + i, _mm256_andnot_ps(low, y));
+        
+        // reset the previous position of the particles moved to y = 0.
+        const __m256 moved = _mm256_andnot_ps(_mm256_cmp_ps(y, zero, _CMP_EQ_OQ), low);
+        const __m256 px = _mm256_loadu_ps(p.px + i);
+        const __m256 py = _mm256_loadu_ps(p.py + i);
+        const __m256 pz = _mm256_loadu_ps(p.pz + i);
+        _mm256_storeu_ps(p.px + i, select8(moved, x, px));
+        _mm256_storeu_ps(p.py + i, _mm256_andnot_ps(moved, py));
+        _mm256_storeu_ps(p.pz + i, select8(moved, _mm256_loadu_ps(p.z + i), pz));
+        
+        const int hits = _mm256_movemask_ps(_mm256_or_ps(side, stop));
+        for(GLuint k = 0; k < 8; k++) {
+            p.out[i + k] = (hits >> k) & 1;
+        }
+        count += __builtin_popcount(hits);
+    }
+    
+    return count + bounceScalar(p, i, n, bounds);
+}
+
+#endif // OGLE_SIMD_X86
+
+//==============================================================================
+
+SimdLevel getSupportedSimdLevel() {
+#ifdef OGLE_SIMD_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")) {
+        return SIMD_AVX2;
+    }
+    if(__builtin_cpu_supports("sse2")) {
+        return SIMD_SSE2;
+    }
+#endif
+    return SIMD_SCALAR;
+}
+
+/// Level in use. Detected by a static initializer, so it's set before main()
+/// and before any job can read it; until then it's zero, SIMD_SCALAR.
+static SimdLevel s_level = getSupportedSimdLevel();
+
+SimdLevel getSimdLevel() {
+    return s_level;
+}
+
+void setSimdLevel(SimdLevel level) {
+    s_level = std::min(level, getSupportedSimdLevel());
+}
+
+void integrateParticles(ParticleStorage& storage, const GLuint& begin, const GLuint& end) {
+    if(begin >= end) {
+        return;
+    }
+    
+    IntegrateArrays p;
+    p.x       = &storage.x[begin];
+    p.y       = &storage.y[begin];
+    p.z       = &storage.z[begin];
+    p.xv      = &storage.xv[begin];
+    p.yv      = &storage.yv[begin];
+    p.zv      = &storage.zv[begin];
+    p.life    = &storage.life[begin];
+    p.gravity = &storage.gravity[begin];
+    p.fade    = &storage.fade[begin];
+    p.active  = &storage.active[begin];
+    
+    const GLuint n = end - begin;
+    switch(getSimdLevel()) {
+#ifdef OGLE_SIMD_X86
+        case SIMD_AVX2:
+            integrateAvx2(p, 0, n);
+            break;
+        case SIMD_SSE2:
+            integrateSse2(p, 0, n);
+            break;
+#endif
+        default:
+            integrateScalar(p, 0, n);
+            break;
+    }
+}
+
+GLuint bounceParticles(ParticleStorage& storage, const GLuint& begin, const GLuint& end, const Rect& bounds, GLubyte* const out) {
+    if(begin >= end) {
+        return 0;
+    }
+    
+    BounceArrays p;
+    p.x        = &storage.x[begin];
+    p.y        = &storage.y[begin];
+    p.z        = &storage.z[begin];
+    p.px       = &storage.px[begin];
+    p.py       = &storage.py[begin];
+    p.pz       = &storage.pz[begin];
+    p.xv       = &storage.xv[begin];
+    p.yv       = &storage.yv[begin];
+    p.gravity  = &storage.gravity[begin];
+    p.eligible = &storage.collisionEligible[begin];
+    p.out      = out;
+    
+    const GLuint n = end - begin;
+    switch(getSimdLevel()) {
+#ifdef OGLE_SIMD_X86
+        case SIMD_AVX2:
+            return bounceAvx2(p, 0, n, bounds);
+        case SIMD_SSE2:
+            return bounceSse2(p, 0, n, bounds);
+#endif
+        default:
+            return bounceScalar(p, 0, n, bounds);
+    }
+}
+
+} // namespace ogle
@@ -0,0 +1,116 @@
+//      simd.hpp
+//      
+//      Copyright 2010 Kevin Pors <krpors@users.sf.net>
+//      
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//      
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//      
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//      MA 02110-1301, USA.
+
+#ifndef SIMD_HPP
+#define SIMD_HPP
+
+#include "core.hpp"
+
+#include <GL/gl.h>
+
+namespace ogle {
+
+/**
+ * Instruction set levels for the vectorized kernels. The best level supported
+ * by the CPU is detected at runtime, during static initialization.
+ */
+enum SimdLevel {
+    /// Plain C++, one particle at a time.
+    SIMD_SCALAR = 0,
+    
+    /// SSE2, four particles per instruction.
+    SIMD_SSE2 = 1,
+    
+    /// AVX2, eight particles per instruction.
+    SIMD_AVX2 = 2
+};
+
+/**
+ * Gets the instruction set level used by the kernels.
+ * 
+ * @return The level in use.
+ */
+SimdLevel getSimdLevel();
+
+/**
+ * Gets the best instruction set level supported by the CPU and this build.
+ * 
+ * @return The best supported level.
+ */
+SimdLevel getSupportedSimdLevel();
+
+/**
+ * Forces the kernels to use the given instruction set level, for example to 
+ * compare results or timings. Levels higher than supported by the CPU are 
+ * lowered to the best supported level. The level is read by the kernels 
+ * without synchronization, so this must not be called while a step is being
+ * simulated, on any thread.
+ * 
+ * @param level The level to use.
+ */
+void setSimdLevel(SimdLevel level);
+
+/**
+ * Integrates the particles in the range [begin, end) of the storage by one
+ * step. For every particle which is alive (life > 0 and active) this does 
+ * exactly what ParticleGenerator::step() did per particle:
+ * 
+ * <pre>
+ *  x += xv; y += yv; z += zv;
+ *  yv += gravity;
+ *  life = max(0, life + fade);
+ * </pre>
+ * 
+ * Particles which are not alive are left untouched.
+ * 
+ * @param storage The particle storage.
+ * @param begin The index of the first particle.
+ * @param end One past the index of the last particle.
+ */
+void integrateParticles(ParticleStorage& storage, const GLuint& begin, const GLuint& end);
+
+/**
+ * Finds the particles in the range [begin, end) of the storage which are out
+ * of bounds, and applies the default response of 
+ * CollisionBehavior::boundsCollided() to them, without branches:
+ * 
+ * <pre>
+ *  if x <= bounds.x or x >= bounds.w: xv = -xv; gravity -= 0.005
+ *  else if y <= bounds.y:             y = 0; yv = 0; xv = 0
+ *  else if y >= bounds.h:             yv = 0; xv = 0
+ * </pre>
+ * 
+ * Only particles which are eligible for collisions are checked. A particle 
+ * which is moved gets its previous position reset, like a particle stored 
+ * using ParticleStorage::store().
+ * 
+ * @param storage The particle storage.
+ * @param begin The index of the first particle.
+ * @param end One past the index of the last particle.
+ * @param bounds The bounds, where w and h are the maximum x and y.
+ * @param out Receives 1 for every particle out of bounds, 0 otherwise, 
+ *   starting at out[0] for the particle at begin.
+ * @return The amount of particles out of bounds.
+ */
+GLuint bounceParticles(ParticleStorage& storage, const GLuint& begin, const GLuint& end, const Rect& bounds, GLubyte* const out);
+
+} // namespace ogle
+
+
+#endif // SIMD_HPP
@@ -0,0 +1,374 @@
+//      tree.cpp
+//      
+//      Copyright 2010 Kevin Pors <krpors@users.sf.net>
+//      
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//      
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//      
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//      MA 02110-1301, USA.
+
+#include "tree.hpp"
+
+#include <algorithm>
+
+namespace ogle {
+
+/**
+ * Gets the box of a rectangle as minimum and maximum coordinates. Rectangles 
+ * with a negative size extend to the left or bottom.
+ */
+static inline void toBox(const Rect& r, GLfloat& minX, GLfloat& minY, GLfloat& maxX, GLfloat& maxY) {
+    minX = std::min(r.x, r.x + r.w);
+    maxX = std::max(r.x, r.x + r.w);
+    minY = std::min(r.y, r.y + r.h);
+    maxY = std::max(r.y, r.y + r.h);
+}
+
+/**
+ * Gets the perimeter of the union of two boxes, the cost used to place leaves.
+ */
+template<class A, class B>
+static inline GLfloat unionPerimeter(const A& a, const B& b) {
+    return 2.0f * ((std::max(a.maxX, b.maxX) - std::min(a.minX, b.minX)) + 
+                   (std::max(a.maxY, b.maxY) - std::min(a.minY, b.minY)));
+}
+
+template<class A>
+static inline GLfloat perimeter(const A& a) {
+    return 2.0f * ((a.maxX - a.minX) + (a.maxY - a.minY));
+}
+
+DynamicTree::DynamicTree(const GLfloat& margin) :
+        m_root(NULL_NODE),
+        m_free(NULL_NODE),
+        m_count(0),
+        m_margin(margin) {
+}
+
+DynamicTree::~DynamicTree() {
+}
+
+GLint DynamicTree::allocate() {
+    GLint node = m_free;
+    if(node == NULL_NODE) {
+        node = m_nodes.size();
+        m_nodes.push_back(Node());
+    } else {
+        m_free = m_nodes[node].parent;
+    }
+    Node& n = m_nodes[node];
+    n.object = NULL;
+    n.parent = NULL_NODE;
+    n.left   = NULL_NODE;
+    n.right  = NULL_NODE;
+    n.height = 0;
+    return node;
+}
+
+void DynamicTree::release(const GLint& node) {
+    m_nodes[node].parent = m_free;
+    m_nodes[node].height = -1;
+    m_free = node;
+}
+
+void DynamicTree::fatten(const GLint& leaf) {
+    Node& n = m_nodes[leaf];
+    toBox(n.object->getBoundary(), n.minX, n.minY, n.maxX, n.maxY);
+    n.minX -= m_margin;
+    n.minY -= m_margin;
+    n.maxX += m_margin;
+    n.maxY += m_margin;
+}
+
+GLint DynamicTree::insert(Object* const object) {
+    const GLint leaf = allocate();
+    m_nodes[leaf].object = object;
+    fatten(leaf);
+    insertLeaf(leaf);
+    m_count++;
+    return leaf;
+}
+
+void DynamicTree::remove(const GLint& proxy) {
+    removeLeaf(proxy);
+    release(proxy);
+    m_count--;
+}
+
+bool DynamicTree::update(const GLint& proxy) {
+    GLfloat minX, minY, maxX, maxY;
+    toBox(m_nodes[proxy].object->getBoundary(), minX, minY, maxX, maxY);
+    const Node& n = m_nodes[proxy];
+    if(n.minX <= minX && n.minY <= minY && maxX <= n.maxX && maxY <= n.maxY) {
+        return false;
+    }
+    removeLeaf(proxy);
+    fatten(proxy);
+    insertLeaf(proxy);
+    return true;
+}
+
+Object* DynamicTree::getObject(const GLint& proxy) const {
+    return m_nodes[proxy].object;
+}
+
+const GLuint& DynamicTree::getSize() const {
+    return m_count;
+}
+
+GLint DynamicTree::getHeight() const {
+    return m_root == NULL_NODE ? 0 : m_nodes[m_root].height;
+}
+
+void DynamicTree::insertLeaf(const GLint& leaf) {
+    if(m_root == NULL_NODE) {
+        m_root = leaf;
+        m_nodes[leaf].parent = NULL_NODE;
+        return;
+    }
+    
+    // walk down to the best sibling: the one where adding the leaf increases
+    // the perimeters of the boxes the least.
+    const Node box = m_nodes[leaf];
+    GLint index = m_root;
+    while(m_nodes[index].left != NULL_NODE) {
+        const Node& n = m_nodes[index];
+        const GLfloat combined = unionPerimeter(n, box);
+        
+        // cost of making a new parent for this node and the leaf.
+        const GLfloat cost = 2.0f * combined;
+        
+        // cost of pushing the leaf further down, which grows this node.
+        const GLfloat inherited = 2.0f * (combined - perimeter(n));
+        
+        GLfloat costs[2];
+        const GLint children[2] = { n.left, n.right };
+        for(GLuint k = 0; k < 2; k++) {
+            const Node& child = m_nodes[children[k]];
+            costs[k] = unionPerimeter(child, box) + inherited;
+            if(child.left != NULL_NODE) {
+                costs[k] -= perimeter(child);
+            }
+        }
+        
+        if(cost < costs[0] && cost < costs[1]) {
+            break;
+        }
+        index = costs[0] < costs[1] ? children[0] : children[1];
+    }
+    
+    const GLint sibling = index;
+    const GLint oldParent = m_nodes[sibling].parent;
+    const GLint parent = allocate();
+    m_nodes[parent].parent = oldParent;
+    m_nodes[parent].left = sibling;
+    m_nodes[parent].right = leaf;
+    m_nodes[sibling].parent = parent;
+    m_nodes[leaf].parent = parent;
+    
+    if(oldParent == NULL_NODE) {
+        m_root = parent;
+    } else if(m_nodes[oldParent].left == sibling) {
+        m_nodes[oldParent].left = parent;
+    } else {
+        m_nodes[oldParent].right = parent;
+    }
+    
+    refit(parent);
+}
+
+void DynamicTree::removeLeaf(const GLint& leaf) {
+    if(leaf == m_root) {
+        m_root = NULL_NODE;
+        return;
+    }
+    
+    // the sibling takes the place of the parent.
+    const GLint parent = m_nodes[leaf].parent;
+    const GLint grandParent = m_nodes[parent].parent;
+    const GLint sibling = m_nodes[parent].left == leaf ? m_nodes[parent].right : m_nodes[parent].left;
+    
+    m_nodes[sibling].parent = grandParent;
+    release(parent);
+    
+    if(grandParent == NULL_NODE) {
+        m_root = sibling;
+        return;
+    }
+    if(m_nodes[grandParent].left == parent) {
+        m_nodes[grandParent].left = sibling;
+    } else {
+        m_nodes[grandParent].right = sibling;
+    }
+    refit(grandParent);
+}
+
+/**
+ * Sets the box and height of a node from its two children.
+ */
+template<class N>
+static inline void join(N& node, const N& a, const N& b) {
+    node.minX = std::min(a.minX, b.minX);
+    node.minY = std::min(a.minY, b.minY);
+    node.maxX = std::max(a.maxX, b.maxX);
+    node.maxY = std::max(a.maxY, b.maxY);
+    node.height = 1 + std::max(a.height, b.height);
+}
+
+void DynamicTree::refit(GLint node) {
+    while(node != NULL_NODE) {
+        node = balance(node);
+        
+        Node& n = m_nodes[node];
+        join(n, m_nodes[n.left], m_nodes[n.right]);
+        node = n.parent;
+    }
+}
+
+GLint DynamicTree::balance(const GLint& a) {
+    if(m_nodes[a].left == NULL_NODE || m_nodes[a].height < 2) {
+        return a;
+    }
+    
+    const GLint b = m_nodes[a].left;
+    const GLint c = m_nodes[a].right;
+    const GLint difference = m_nodes[c].height - m_nodes[b].height;
+    if(difference >= -1 && difference <= 1) {
+        return a;
+    }
+    
+    /*
+     * Rotate the higher child up, so it becomes the parent of a. Of the two 
+     * children of that child, the higher one stays with it, and the lower one
+     * takes its place under a:
+     * 
+     *       a              up
+     *      / \            /  \
+     *   other  up   =>    a   higher
+     *         /  \       / \
+     *    higher lower other lower
+     * 
+     * Or the mirror image of that, when the left child is the higher one.
+     */
+    const bool rightUp = difference > 1;
+    const GLint up    = rightUp ? c : b;
+    const GLint f = m_nodes[up].left;
+    const GLint g = m_nodes[up].right;
+    const GLint higher = m_nodes[f].height > m_nodes[g].height ? f : g;
+    const GLint lower  = higher == f ? g : f;
+    
+    // up takes the place of a.
+    const GLint parent = m_nodes[a].parent;
+    m_nodes[up].parent = parent;
+    if(parent == NULL_NODE) {
+        m_root = up;
+    } else if(m_nodes[parent].left == a) {
+        m_nodes[parent].left = up;
+    } else {
+        m_nodes[parent].right = up;
+    }
+    
+    m_nodes[up].left = a;
+    m_nodes[up].right = higher;
+    m_nodes[a].parent = up;
+    
+    if(rightUp) {
+        m_nodes[a].right = lower;
+    } else {
+        m_nodes[a].left = lower;
+    }
+    m_nodes[lower].parent = a;
+    
+    join(m_nodes[a], m_nodes[m_nodes[a].left], m_nodes[m_nodes[a].right]);
+    join(m_nodes[up], m_nodes[a], m_nodes[higher]);
+    return up;
+}
+
+void DynamicTree::collect(const GLfloat& minX, const GLfloat& minY, const GLfloat& maxX, const GLfloat& maxY, std::vector<GLint>& leaves) {
+    if(m_root == NULL_NODE) {
+        return;
+    }
+    m_stack.clear();
+    m_stack.push_back(m_root);
+    while(!m_stack.empty()) {
+        const GLint index = m_stack.back();
+        m_stack.pop_back();
+        
+        const Node& n = m_nodes[index];
+        if(n.maxX < minX || n.minX > maxX || n.maxY < minY || n.minY > maxY) {
+            continue;
+        }
+        if(n.left == NULL_NODE) {
+            leaves.push_back(index);
+        } else {
+            m_stack.push_back(n.left);
+            m_stack.push_back(n.right);
+        }
+    }
+}
+
+void DynamicTree::queryPoint(const GLfloat& x, const GLfloat& y, std::vector<Object*>& objects) {
+    m_found.clear();
+    collect(x, y, x, y, m_found);
+    std::vector<GLint>::const_iterator it;
+    for(it = m_found.begin(); it != m_found.end(); it++) {
+        Object* object = m_nodes[*it].object;
+        GLfloat minX, minY, maxX, maxY;
+        toBox(object->getBoundary(), minX, minY, maxX, maxY);
+        if(minX <= x && x <= maxX && minY <= y && y <= maxY) {
+            objects.push_back(object);
+        }
+    }
+}
+
+void DynamicTree::queryRect(const Rect& rect, std::vector<Object*>& objects) {
+    GLfloat minX, minY, maxX, maxY;
+    toBox(rect, minX, minY, maxX, maxY);
+    m_found.clear();
+    collect(minX, minY, maxX, maxY, m_found);
+    std::vector<GLint>::const_iterator it;
+    for(it = m_found.begin(); it != m_found.end(); it++) {
+        Object* object = m_nodes[*it].object;
+        if(object->getBoundary().intersects(rect)) {
+            objects.push_back(object);
+        }
+    }
+}
+
+void DynamicTree::queryPairs(std::vector<std::pair<Object*, Object*> >& pairs) {
+    for(GLint leaf = 0; leaf < static_cast<GLint>(m_nodes.size()); leaf++) {
+        const Node& n = m_nodes[leaf];
+        if(n.height != 0) {
+            continue;
+        }
+        m_found.clear();
+        collect(n.minX, n.minY, n.maxX, n.maxY, m_found);
+        // sorted, so the pairs come out in a fixed order.
+        std::sort(m_found.begin(), m_found.end());
+        
+        Object* one = n.object;
+        const Rect box = one->getBoundary();
+        std::vector<GLint>::const_iterator it;
+        for(it = m_found.begin(); it != m_found.end(); it++) {
+            if(*it <= leaf) {
+                continue;
+            }
+            Object* two = m_nodes[*it].object;
+            if(box.intersects(two->getBoundary())) {
+                pairs.push_back(std::make_pair(one, two));
+            }
+        }
+    }
+}
+
+} // namespace ogle
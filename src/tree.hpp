@@ -0,0 +1,200 @@
+//      tree.hpp
+//      
+//      Copyright 2010 Kevin Pors <krpors@users.sf.net>
+//      
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//      
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//      
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//      MA 02110-1301, USA.
+
+#ifndef TREE_HPP
+#define TREE_HPP
+
+#include "core.hpp"
+
+#include <GL/gl.h>
+#include <utility>
+#include <vector>
+
+namespace ogle {
+
+/**
+ * Dynamic bounding volume tree, indexing Objects by their boundary. Every
+ * object is stored in a leaf with a fattened box: its boundary grown by a 
+ * margin, so small movements do not require the tree to change. The leaves are
+ * placed to keep the boxes of their parents small, and the tree is kept 
+ * balanced, so queries and changes take <code>O(log n)</code>.
+ * 
+ * Objects are identified by the proxy returned by insert(). The tree does not
+ * take ownership of the objects. Whenever an object moves or changes size, 
+ * call update() with its proxy.
+ */
+class DynamicTree {
+private:
+    /// A node of the tree, either a leaf with an object, or a parent of two nodes.
+    struct Node {
+        /// The (fattened) box, as minimum and maximum coordinates.
+        GLfloat minX, minY, maxX, maxY;
+        
+        /// The object of a leaf, NULL for other nodes.
+        Object* object;
+        
+        /// The parent node, or the next free node when this one is free.
+        GLint parent;
+        
+        /// The children, or NULL_NODE for a leaf.
+        GLint left, right;
+        
+        /// Height of the subtree: 0 for a leaf, -1 for a free node.
+        GLint height;
+    };
+    
+    /// The nodes; free nodes are chained through Node::parent.
+    std::vector<Node> m_nodes;
+    
+    /// The root node, or NULL_NODE when empty.
+    GLint m_root;
+    
+    /// The first free node, or NULL_NODE.
+    GLint m_free;
+    
+    /// Amount of objects in the tree.
+    GLuint m_count;
+    
+    /// Margin to fatten the boxes of the leaves with.
+    GLfloat m_margin;
+    
+    /// Nodes left to visit during a query.
+    std::vector<GLint> m_stack;
+    
+    /// Leaves found during queryPairs().
+    std::vector<GLint> m_found;
+    
+    GLint allocate();
+    
+    void release(const GLint& node);
+    
+    void insertLeaf(const GLint& leaf);
+    
+    void removeLeaf(const GLint& leaf);
+    
+    /**
+     * Sets the box of a leaf to the fattened boundary of its object.
+     */
+    void fatten(const GLint& leaf);
+    
+    /**
+     * Recalculates the boxes and heights from the given node up to the root,
+     * balancing the tree on the way.
+     */
+    void refit(GLint node);
+    
+    /**
+     * Rotates the subtree at the given node when it is out of balance.
+     * 
+     * @return The node at the top of the subtree afterwards.
+     */
+    GLint balance(const GLint& node);
+    
+    /**
+     * Finds the leaves whose box overlaps the given box.
+     */
+    void collect(const GLfloat& minX, const GLfloat& minY, const GLfloat& maxX, const GLfloat& maxY, std::vector<GLint>& leaves);
+
+public:
+    /// Proxy value which never refers to an object.
+    static const GLint NULL_NODE = -1;
+    
+    /**
+     * Creates an empty tree.
+     * 
+     * @param margin The distance to fatten the boxes of the objects with.
+     */
+    DynamicTree(const GLfloat& margin = 0.1f);
+    
+    ~DynamicTree();
+    
+    /**
+     * Adds an object.
+     * 
+     * @param object The object.
+     * @return The proxy of the object, to update or remove it.
+     */
+    GLint insert(Object* const object);
+    
+    /**
+     * Removes an object.
+     * 
+     * @param proxy The proxy returned by insert().
+     */
+    void remove(const GLint& proxy);
+    
+    /**
+     * Updates the tree after the object of the proxy moved or changed size. 
+     * The tree only changes when the boundary left its fattened box.
+     * 
+     * @param proxy The proxy returned by insert().
+     * @return true when the tree changed.
+     */
+    bool update(const GLint& proxy);
+    
+    /**
+     * Gets the object of a proxy.
+     * 
+     * @param proxy The proxy returned by insert().
+     * @return The object.
+     */
+    Object* getObject(const GLint& proxy) const;
+    
+    /**
+     * Gets the amount of objects in the tree.
+     */
+    const GLuint& getSize() const;
+    
+    /**
+     * Gets the height of the tree, which is 0 for a single object, and about
+     * <code>log2(n)</code> for n objects.
+     */
+    GLint getHeight() const;
+    
+    /**
+     * Finds the objects whose boundary contains a point, borders included.
+     * 
+     * @param x The x coordinate.
+     * @param y The y coordinate.
+     * @param objects The vector to append the objects to.
+     */
+    void queryPoint(const GLfloat& x, const GLfloat& y, std::vector<Object*>& objects);
+    
+    /**
+     * Finds the objects whose boundary intersects a rectangle, like 
+     * Rect::intersects().
+     * 
+     * @param rect The rectangle, as (x, y) and (w, h), like Object::getBoundary().
+     * @param objects The vector to append the objects to.
+     */
+    void queryRect(const Rect& rect, std::vector<Object*>& objects);
+    
+    /**
+     * Finds all pairs of objects in the tree whose boundaries intersect. Every 
+     * pair is reported once, the object with the lowest proxy first.
+     * 
+     * @param pairs The vector to append the pairs to.
+     */
+    void queryPairs(std::vector<std::pair<Object*, Object*> >& pairs);
+};
+
+} // namespace ogle
+
+
+#endif // TREE_HPP
@@ -18,6 +18,7 @@
 //      MA 02110-1301, USA.
 
 #include "utils.hpp"
+#include "vec3.hpp"
 
 namespace ogle {
 
@@ -42,11 +43,8 @@ void Vertex::normalize() {
 
 // static:
 Vertex Vertex::calcNormal(const Vertex& a, const Vertex& b) {
-    Vertex c;
-    c.x = (a.y * b.z) - (a.z - b.y);
-    c.y = (a.z * b.x) - (a.x - b.z);
-    c.z = (a.x * b.y) - (a.y - b.x);
-    return c; 
+    const Vec3 n = ogle::normalize(cross(Vec3(a.x, a.y, a.z), Vec3(b.x, b.y, b.z)));
+    return Vertex(n.x, n.y, n.z);
 }
 
 //==============================================================================
@@ -45,7 +45,7 @@ public:
 
     /**
      * Calculates and returns the surface normal based on two vertices in the 
-     * Euclidian space.
+     * Euclidian space: the normalized cross product a x b.
      * 
      * @param a The first vertex.
      * @param b The second vertex.
@@ -0,0 +1,170 @@
+//      vec3.hpp
+//      
+//      Copyright 2010 Kevin Pors <krpors@users.sf.net>
+//      
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//      
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//      
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//      MA 02110-1301, USA.
+
+#ifndef VEC3_HPP
+#define VEC3_HPP
+
+#include <GL/gl.h>
+#include <math.h>
+
+namespace ogle {
+
+/**
+ * A vector in the three dimensional space, used for normals and directions.
+ * Vec3 is three packed floats without padding, so an array of them can be
+ * written straight into a vertex buffer. All operations are inline, so the 
+ * compiler can fold the ones with constant operands at compile time.
+ */
+class Vec3 {
+public:
+    /// The x component.
+    GLfloat x;
+    
+    /// The y component.
+    GLfloat y;
+    
+    /// The z component.
+    GLfloat z;
+    
+    /**
+     * Creates a vector. The default is the zero vector.
+     */
+    Vec3(const GLfloat& xx = 0.0f, const GLfloat& yy = 0.0f, const GLfloat& zz = 0.0f) :
+            x(xx), y(yy), z(zz) {
+    }
+    
+    Vec3 operator-() const {
+        return Vec3(-x, -y, -z);
+    }
+    
+    Vec3 operator+(const Vec3& v) const {
+        return Vec3(x + v.x, y + v.y, z + v.z);
+    }
+    
+    Vec3 operator-(const Vec3& v) const {
+        return Vec3(x - v.x, y - v.y, z - v.z);
+    }
+    
+    Vec3 operator*(const GLfloat& s) const {
+        return Vec3(x * s, y * s, z * s);
+    }
+    
+    Vec3 operator/(const GLfloat& s) const {
+        return Vec3(x / s, y / s, z / s);
+    }
+    
+    Vec3& operator+=(const Vec3& v) {
+        x += v.x;
+        y += v.y;
+        z += v.z;
+        return *this;
+    }
+    
+    Vec3& operator-=(const Vec3& v) {
+        x -= v.x;
+        y -= v.y;
+        z -= v.z;
+        return *this;
+    }
+    
+    Vec3& operator*=(const GLfloat& s) {
+        x *= s;
+        y *= s;
+        z *= s;
+        return *this;
+    }
+    
+    bool operator==(const Vec3& v) const {
+        return x == v.x && y == v.y && z == v.z;
+    }
+    
+    bool operator!=(const Vec3& v) const {
+        return !(*this == v);
+    }
+    
+    /**
+     * Gets the length of this vector.
+     * 
+     * @return The length.
+     */
+    GLfloat length() const {
+        return sqrt(x * x + y * y + z * z);
+    }
+};
+
+/**
+ * Scales a vector, with the scalar on the left.
+ */
+inline Vec3 operator*(const GLfloat& s, const Vec3& v) {
+    return v * s;
+}
+
+/**
+ * Gets the dot product of two vectors.
+ * 
+ * @param a The first vector.
+ * @param b The second vector.
+ * @return The dot product.
+ */
+inline GLfloat dot(const Vec3& a, const Vec3& b) {
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+/**
+ * Gets the cross product of two vectors. The result is perpendicular to both,
+ * following the right hand rule: cross(UNIT_X, UNIT_Y) is UNIT_Z.
+ * 
+ * @param a The first vector.
+ * @param b The second vector.
+ * @return The cross product a x b.
+ */
+inline Vec3 cross(const Vec3& a, const Vec3& b) {
+    return Vec3(a.y * b.z - a.z * b.y,
+                a.z * b.x - a.x * b.z,
+                a.x * b.y - a.y * b.x);
+}
+
+/**
+ * Gets the vector with the same direction and a length of one. The zero 
+ * vector is returned as is.
+ * 
+ * @param v The vector.
+ * @return The normalized vector.
+ */
+inline Vec3 normalize(const Vec3& v) {
+    const GLfloat len = v.length();
+    return len > 0.0f ? v / len : v;
+}
+
+// The axis constants are defined here rather than in a source file, so every
+// user sees their values and the compiler can fold them. Being const, each
+// translation unit gets its own copy.
+
+/// The unit vector along the x-axis.
+const Vec3 UNIT_X(1.0f, 0.0f, 0.0f);
+
+/// The unit vector along the y-axis.
+const Vec3 UNIT_Y(0.0f, 1.0f, 0.0f);
+
+/// The unit vector along the z-axis.
+const Vec3 UNIT_Z(0.0f, 0.0f, 1.0f);
+
+} // namespace ogle
+
+#endif // VEC3_HPP
@@ -0,0 +1,321 @@
+//      broadphase_test.cpp
+//      
+//      Copyright 2010 Kevin Pors <krpors@users.sf.net>
+//      
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//      
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//      
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//      MA 02110-1301, USA.
+
+/*
+ * Checks that SpatialHash and SweepAndPrune report exactly the intersecting
+ * pairs which BruteForceBroadphase reports, each pair once, and that a 
+ * CollisionDetector fires the same callbacks with any of them as without a
+ * broadphase, with and without a JobPool.
+ */
+
+#include "../src/broadphase.hpp"
+#include "../src/collision.hpp"
+#include "../src/core.hpp"
+#include "../src/jobs.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <vector>
+
+/// Failed checks so far.
+static int failures = 0;
+
+static GLfloat random(GLfloat min, GLfloat max) {
+    return min + (max - min) * (rand() / static_cast<GLfloat>(RAND_MAX));
+}
+
+/**
+ * Makes boxes of all kinds: small ones around the origin including negative
+ * coordinates, boxes without a size, boxes exactly touching on cell 
+ * boundaries, boxes spanning many cells, and boxes very far away.
+ */
+static std::vector<ogle::Rect> makeBoxes(GLuint count) {
+    std::vector<ogle::Rect> boxes;
+    for(GLuint i = 0; i < count; i++) {
+        ogle::Rect box(random(-50.0f, 50.0f), random(-50.0f, 50.0f), random(0.5f, 4.0f), random(0.5f, 4.0f));
+        switch(i % 10) {
+            case 0:
+                // no size at all.
+                box.w = 0.0f;
+                box.h = 0.0f;
+                break;
+            case 1:
+                // on whole coordinates, so boxes touch exactly.
+                box.x = static_cast<GLfloat>(static_cast<GLint>(box.x));
+                box.y = static_cast<GLfloat>(static_cast<GLint>(box.y));
+                box.w = 2.0f;
+                box.h = 2.0f;
+                break;
+            case 2:
+                // a line, one of the sizes zero.
+                box.w = 0.0f;
+                box.h = random(5.0f, 30.0f);
+                break;
+            default:
+                break;
+        }
+        boxes.push_back(box);
+    }
+    // spanning many cells, up to the whole area.
+    boxes.push_back(ogle::Rect(-60.0f, -60.0f, 120.0f, 120.0f));
+    boxes.push_back(ogle::Rect(-40.0f, 10.0f, 80.0f, 1.0f));
+    boxes.push_back(ogle::Rect(-5.0f, -45.0f, 3.0f, 70.0f));
+    // far away, beyond what fits in the cell coordinates.
+    boxes.push_back(ogle::Rect(1e12f, 1e12f, 1.0f, 1.0f));
+    boxes.push_back(ogle::Rect(1e12f, 1e12f, 2.0f, 2.0f));
+    boxes.push_back(ogle::Rect(-1e12f, -3.0f, 2e12f, 1.0f));
+    return boxes;
+}
+
+/**
+ * Keeps the pairs which intersect, sorted.
+ */
+static std::vector<ogle::CollisionPair> intersecting(const std::vector<ogle::Rect>& boxes, const std::vector<ogle::CollisionPair>& pairs) {
+    std::vector<ogle::CollisionPair> result;
+    std::vector<ogle::CollisionPair>::const_iterator it;
+    for(it = pairs.begin(); it != pairs.end(); it++) {
+        if(boxes[it->first].intersects(boxes[it->second])) {
+            result.push_back(*it);
+        }
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+static std::vector<ogle::CollisionPair> intersecting(const std::vector<ogle::AABB3>& boxes, const std::vector<ogle::CollisionPair>& pairs) {
+    std::vector<ogle::CollisionPair> result;
+    std::vector<ogle::CollisionPair>::const_iterator it;
+    for(it = pairs.begin(); it != pairs.end(); it++) {
+        if(boxes[it->first].intersects(boxes[it->second])) {
+            result.push_back(*it);
+        }
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+/**
+ * Checks the candidates of a broadphase against the reference: every pair 
+ * ordered and reported once, and the same intersecting pairs.
+ */
+template <class T>
+static void check(const char* name, const std::vector<T>& boxes, std::vector<ogle::CollisionPair> pairs, const std::vector<ogle::CollisionPair>& expected) {
+    std::vector<ogle::CollisionPair>::const_iterator it;
+    for(it = pairs.begin(); it != pairs.end(); it++) {
+        if(it->first >= it->second || it->second >= boxes.size()) {
+            std::cerr << "FAIL: " << name << " reports invalid pair " << it->first << ", " << it->second << std::endl;
+            failures++;
+            return;
+        }
+    }
+    std::sort(pairs.begin(), pairs.end());
+    if(std::adjacent_find(pairs.begin(), pairs.end()) != pairs.end()) {
+        std::cerr << "FAIL: " << name << " reports a pair more than once" << std::endl;
+        failures++;
+    }
+    const std::vector<ogle::CollisionPair> found = intersecting(boxes, pairs);
+    if(found != expected) {
+        std::cerr << "FAIL: " << name << " reports " << found.size() << " intersecting pairs, expected " 
+                  << expected.size() << " for " << boxes.size() << " boxes" << std::endl;
+        failures++;
+    }
+}
+
+static void compare2D(GLuint count) {
+    std::vector<ogle::Rect> boxes = makeBoxes(count);
+    
+    ogle::BruteForceBroadphase brute;
+    ogle::SpatialHash automatic;
+    ogle::SpatialHash small(0.5f);
+    ogle::SpatialHash large(25.0f);
+    ogle::SweepAndPrune sweepX(ogle::SWEEP_X);
+    ogle::SweepAndPrune sweepY(ogle::SWEEP_Y);
+    
+    // twice, with the boxes moved in between, since the broadphases keep 
+    // state between calls.
+    for(GLuint round = 0; round < 2; round++) {
+        std::vector<ogle::CollisionPair> all;
+        brute.findPairs(boxes, all);
+        const std::vector<ogle::CollisionPair> expected = intersecting(boxes, all);
+        
+        std::vector<ogle::CollisionPair> pairs;
+        automatic.findPairs(boxes, pairs);
+        check("SpatialHash (automatic cells)", boxes, pairs, expected);
+        pairs.clear();
+        small.findPairs(boxes, pairs);
+        check("SpatialHash (small cells)", boxes, pairs, expected);
+        pairs.clear();
+        large.findPairs(boxes, pairs);
+        check("SpatialHash (large cells)", boxes, pairs, expected);
+        pairs.clear();
+        sweepX.findPairs(boxes, pairs);
+        check("SweepAndPrune (x)", boxes, pairs, expected);
+        pairs.clear();
+        sweepY.findPairs(boxes, pairs);
+        check("SweepAndPrune (y)", boxes, pairs, expected);
+        
+        for(GLuint i = 0; i < count; i++) {
+            boxes[i].x += random(-2.0f, 2.0f);
+            boxes[i].y += random(-2.0f, 2.0f);
+        }
+    }
+}
+
+static void compare3D(GLuint count) {
+    const std::vector<ogle::Rect> rects = makeBoxes(count);
+    std::vector<ogle::AABB3> boxes;
+    for(GLuint i = 0; i < rects.size(); i++) {
+        // some flat, some touching along z.
+        const GLfloat z = (i % 3 == 0) ? 0.0f : static_cast<GLfloat>(static_cast<GLint>(random(-5.0f, 5.0f)));
+        boxes.push_back(ogle::AABB3(rects[i], z, (i % 4 == 0) ? 0.0f : 1.0f));
+    }
+    
+    ogle::BruteForceBroadphase brute;
+    ogle::SpatialHash hash;
+    ogle::SweepAndPrune sweep;
+    
+    std::vector<ogle::CollisionPair> all;
+    brute.findPairs(boxes, all);
+    const std::vector<ogle::CollisionPair> expected = intersecting(boxes, all);
+    
+    std::vector<ogle::CollisionPair> pairs;
+    hash.findPairs(boxes, pairs);
+    check("SpatialHash (3D)", boxes, pairs, expected);
+    pairs.clear();
+    sweep.findPairs(boxes, pairs);
+    check("SweepAndPrune (3D)", boxes, pairs, expected);
+}
+
+/**
+ * Records the callbacks it receives, by particle index, and applies the 
+ * default response to particles out of bounds, like a real behavior would.
+ */
+class RecordingBehavior : public ogle::CollisionBehavior {
+private:
+    /// Indices of the particles of the batch being handled.
+    std::map<ogle::Particle*, GLuint> m_indices;
+    
+public:
+    /// Per callback: 0 and the two particles, or 1 and the particle out of bounds.
+    std::vector<GLuint> calls;
+    
+    virtual void collided(const ogle::CollisionBatch& batch) {
+        m_indices.clear();
+        for(GLuint i = 0; i < batch.particles.size(); i++) {
+            if(batch.particles[i] != NULL) {
+                m_indices[batch.particles[i]] = i;
+            }
+        }
+        ogle::CollisionBehavior::collided(batch);
+    }
+    
+    virtual void particlesCollided(ogle::Particle* const one, ogle::Particle* const two) {
+        calls.push_back(0);
+        calls.push_back(m_indices[one]);
+        calls.push_back(m_indices[two]);
+    }
+    
+    virtual void boundsCollided(ogle::Particle* const particle, const ogle::Rect& bounds) {
+        calls.push_back(1);
+        calls.push_back(m_indices[particle]);
+        ogle::CollisionBehavior::boundsCollided(particle, bounds);
+    }
+};
+
+/**
+ * Simulates a generator with collision checks after every step, and records
+ * the callbacks and the particles in the end. The generator always starts out
+ * the same, so the results only differ when the checks do.
+ */
+static void simulate(ogle::Broadphase* const broadphase, ogle::JobPool* const pool, bool depth, 
+                     std::vector<GLuint>& calls, std::vector<GLfloat>& particles) {
+    ogle::ParticleGenerator generator(0.0f, 0.0f);
+    generator.setMaxParticles(600);
+    generator.setSeed(7);
+    if(depth) {
+        // about half of the particles move far enough along z to be swept.
+        generator.setSpreadZ(-2.0f, 2.0f);
+    }
+    generator.initialize();
+    
+    // bounds on whole coordinates, so some particles end up exactly on them.
+    ogle::CollisionDetector detector(ogle::Rect(-2.0f, -3.0f, 2.0f, 1.0f), broadphase);
+    detector.setJobPool(pool);
+    detector.setDepthCulling(depth);
+    RecordingBehavior behavior;
+    detector.addBehavior(&behavior);
+    
+    for(GLuint step = 0; step < 25; step++) {
+        generator.step();
+        detector.checkCollisions(generator);
+    }
+    
+    calls = behavior.calls;
+    const ogle::ParticleStorage& storage = generator.getStorage();
+    particles.clear();
+    particles.insert(particles.end(), storage.x.begin(), storage.x.end());
+    particles.insert(particles.end(), storage.y.begin(), storage.y.end());
+    particles.insert(particles.end(), storage.xv.begin(), storage.xv.end());
+    particles.insert(particles.end(), storage.yv.begin(), storage.yv.end());
+}
+
+static void compareDetectors(bool depth) {
+    std::vector<GLuint> expectedCalls;
+    std::vector<GLfloat> expectedParticles;
+    simulate(NULL, NULL, depth, expectedCalls, expectedParticles);
+    if(expectedCalls.empty()) {
+        std::cerr << "FAIL: the scene has no collisions" << std::endl;
+        failures++;
+    }
+    
+    ogle::JobPool pool(4);
+    ogle::SpatialHash hash;
+    ogle::SweepAndPrune sweep;
+    const char* names[] = { "no broadphase", "SpatialHash", "SweepAndPrune" };
+    ogle::Broadphase* broadphases[] = { NULL, &hash, &sweep };
+    for(GLuint b = 0; b < 3; b++) {
+        for(GLuint threaded = 0; threaded < 2; threaded++) {
+            std::vector<GLuint> calls;
+            std::vector<GLfloat> particles;
+            simulate(broadphases[b], threaded ? &pool : NULL, depth, calls, particles);
+            if(calls != expectedCalls || particles != expectedParticles) {
+                std::cerr << "FAIL: detector with " << names[b] << (threaded ? " on a pool" : "") 
+                          << (depth ? " in 3D" : "") << " does not fire the same callbacks" << std::endl;
+                failures++;
+            }
+        }
+    }
+}
+
+int main() {
+    srand(1);
+    
+    const GLuint counts[] = { 0, 1, 2, 10, 100, 500 };
+    for(GLuint c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+        compare2D(counts[c]);
+        compare3D(counts[c]);
+    }
+    compareDetectors(false);
+    compareDetectors(true);
+    
+    std::cout << (failures == 0 ? "PASS" : "FAIL") << std::endl;
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
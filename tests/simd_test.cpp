@@ -0,0 +1,167 @@
+//      simd_test.cpp
+//      
+//      Copyright 2010 Kevin Pors <krpors@users.sf.net>
+//      
+//      This program is free software; you can redistribute it and/or modify
+//      it under the terms of the GNU General Public License as published by
+//      the Free Software Foundation; either version 2 of the License, or
+//      (at your option) any later version.
+//      
+//      This program is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU General Public License for more details.
+//      
+//      You should have received a copy of the GNU General Public License
+//      along with this program; if not, write to the Free Software
+//      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+//      MA 02110-1301, USA.
+
+/*
+ * Checks that the SSE2 and AVX2 particle kernels give exactly the same results
+ * as the scalar kernels, for ranges which don't line up with the vector width.
+ */
+
+#include "../src/core.hpp"
+#include "../src/simd.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+/// Particles in the storage of every test.
+const GLuint STORAGE_SIZE = 160;
+
+/// The bounds the particles are bounced against.
+const ogle::Rect BOUNDS(-10.0f, -10.0f, 10.0f, 10.0f);
+
+/// Failed checks so far.
+static int failures = 0;
+
+static GLfloat random(GLfloat min, GLfloat max) {
+    return min + (max - min) * (rand() / static_cast<GLfloat>(RAND_MAX));
+}
+
+/**
+ * Fills a storage with particles which hit all branches of the kernels: dead 
+ * and inactive particles, particles whose life crosses zero this step, and 
+ * particles on, inside and outside the bounds.
+ */
+static void fill(ogle::ParticleStorage& s) {
+    s.resize(STORAGE_SIZE);
+    for(GLuint i = 0; i < STORAGE_SIZE; i++) {
+        s.x[i] = random(-15.0f, 15.0f);
+        s.y[i] = random(-15.0f, 15.0f);
+        s.z[i] = random(-1.0f, 1.0f);
+        switch(i % 7) {
+            case 0: s.x[i] = BOUNDS.x; break;
+            case 1: s.x[i] = BOUNDS.w; break;
+            case 2: s.y[i] = BOUNDS.y; break;
+            case 3: s.y[i] = BOUNDS.h; break;
+            default: break;
+        }
+        s.px[i] = s.x[i];
+        s.py[i] = s.y[i];
+        s.pz[i] = s.z[i];
+        s.xv[i] = random(-1.0f, 1.0f);
+        s.yv[i] = random(-1.0f, 1.0f);
+        s.zv[i] = random(-0.1f, 0.1f);
+        s.gravity[i] = random(-0.03f, -0.01f);
+        s.fade[i] = random(-0.05f, -0.001f);
+        // some particles are dead, some cross zero in this step.
+        switch(i % 5) {
+            case 0: s.life[i] = 0.0f; break;
+            case 1: s.life[i] = random(0.0f, 0.04f); break;
+            default: s.life[i] = random(0.1f, 1.0f); break;
+        }
+        s.active[i] = (i % 3 == 0) ? 0 : 1;
+        s.collisionEligible[i] = (i % 4 == 0) ? 0 : 1;
+    }
+}
+
+static void check(bool ok, const char* what, ogle::SimdLevel level, GLuint begin, GLuint end) {
+    if(!ok) {
+        std::cerr << "FAIL: " << what << " differs at level " << level
+                  << " for [" << begin << ", " << end << ")" << std::endl;
+        failures++;
+    }
+}
+
+static bool same(const ogle::ParticleStorage& a, const ogle::ParticleStorage& b) {
+    return a.x == b.x && a.y == b.y && a.z == b.z &&
+           a.px == b.px && a.py == b.py && a.pz == b.pz &&
+           a.xv == b.xv && a.yv == b.yv && a.zv == b.zv &&
+           a.life == b.life && a.gravity == b.gravity && a.fade == b.fade &&
+           a.active == b.active && a.collisionEligible == b.collisionEligible;
+}
+
+/**
+ * Runs both kernels on [begin, end) at the given level and compares the 
+ * results with the scalar kernels.
+ */
+static void compare(ogle::SimdLevel level, GLuint begin, GLuint end) {
+    ogle::ParticleStorage original;
+    fill(original);
+    
+    ogle::ParticleStorage expected = original;
+    ogle::setSimdLevel(ogle::SIMD_SCALAR);
+    ogle::integrateParticles(expected, begin, end);
+    std::vector<GLubyte> expectedOut(STORAGE_SIZE, 0xff);
+    const GLuint expectedCount = ogle::bounceParticles(expected, begin, end, BOUNDS, &expectedOut[0]);
+    
+    ogle::ParticleStorage actual = original;
+    ogle::setSimdLevel(level);
+    ogle::integrateParticles(actual, begin, end);
+    ogle::ParticleStorage integrated = actual;
+    std::vector<GLubyte> actualOut(STORAGE_SIZE, 0xff);
+    const GLuint actualCount = ogle::bounceParticles(actual, begin, end, BOUNDS, &actualOut[0]);
+    
+    // the integration on its own, so a difference is pinned to a kernel.
+    ogle::ParticleStorage scalarIntegrated = original;
+    ogle::setSimdLevel(ogle::SIMD_SCALAR);
+    ogle::integrateParticles(scalarIntegrated, begin, end);
+    check(same(integrated, scalarIntegrated), "integrateParticles", level, begin, end);
+    
+    check(same(actual, expected), "bounceParticles", level, begin, end);
+    check(actualCount == expectedCount, "bounce count", level, begin, end);
+    check(actualOut == expectedOut, "bounce flags", level, begin, end);
+    
+    // the life is clamped at zero, never below.
+    for(GLuint i = begin; i < end; i++) {
+        check(actual.life[i] >= 0.0f, "life clamp", level, begin, end);
+    }
+    // particles outside the range are untouched.
+    for(GLuint i = 0; i < STORAGE_SIZE; i++) {
+        if(i < begin || i >= end) {
+            check(actual.x[i] == original.x[i] && actual.life[i] == original.life[i], "outside range", level, begin, end);
+        }
+    }
+}
+
+int main() {
+    srand(1);
+    
+    const ogle::SimdLevel supported = ogle::getSupportedSimdLevel();
+    std::cout << "supported level: " << supported << std::endl;
+    
+    // unaligned starts, and lengths around the vector widths.
+    const GLuint begins[] = { 0, 1, 3, 5, 8, 13 };
+    const GLuint counts[] = { 0, 1, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 33, 100, 147 };
+    const ogle::SimdLevel levels[] = { ogle::SIMD_SCALAR, ogle::SIMD_SSE2, ogle::SIMD_AVX2 };
+    
+    for(GLuint l = 0; l < 3; l++) {
+        if(levels[l] > supported) {
+            std::cout << "skipping level " << levels[l] << ", not supported" << std::endl;
+            continue;
+        }
+        for(GLuint b = 0; b < sizeof(begins) / sizeof(begins[0]); b++) {
+            for(GLuint c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+                const GLuint end = std::min(begins[b] + counts[c], STORAGE_SIZE);
+                compare(levels[l], begins[b], end);
+            }
+        }
+    }
+    
+    std::cout << (failures == 0 ? "PASS" : "FAIL") << std::endl;
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}